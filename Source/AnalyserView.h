@@ -0,0 +1,364 @@
+/*
+  ==============================================================================
+
+    AnalyserView.h
+    Background spectrogram and decay analysis, and the editor view showing it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AnalysisTap.h"
+
+//==============================================================================
+/**
+    Drains an AnalysisTap on its own thread and keeps two images up to date:
+    a scrolling spectrogram, and the energy envelope of the last few seconds.
+    It also estimates RT60 from every free decay it sees, fitting a line to
+    the stretch between 5 and 25 dB below the peak and extrapolating to 60 dB.
+
+    Everything is drawn into software images on this thread, so the message
+    thread only ever blits a finished picture. The tap is active for as long
+    as this object exists, unless another analyser already holds it, in
+    which case this one stays idle.
+*/
+class ReverbAnalyser  : private juce::Thread
+{
+public:
+    static constexpr int fft_order = 11;
+    static constexpr int fft_size = 1 << fft_order;
+    static constexpr int hop = fft_size / 4;
+
+    static constexpr int spectrogram_width = 256;    // columns, one per hop
+    static constexpr int spectrogram_height = 128;
+    static constexpr int decay_width = 256;
+    static constexpr int decay_height = 128;
+    static constexpr double decay_seconds = 4.0;
+
+    static constexpr float floor_db = -100.0f;
+
+    ReverbAnalyser (AnalysisTap& t, juce::AudioProcessor& p)
+        : juce::Thread ("Reverb analyser"), tap (t), processor (p)
+    {
+        frame.allocate ((size_t) fft_size, true);
+        fft_data.allocate ((size_t) (2 * fft_size), true);
+        incoming_left.allocate ((size_t) hop, true);
+        incoming_right.allocate ((size_t) hop, true);
+
+        spectrogram = makeImage (spectrogram_width, spectrogram_height);
+        decay = makeImage (decay_width, decay_height);
+        spectrogram_front = spectrogram.createCopy();
+        decay_front = decay.createCopy();
+
+        attached = tap.attachReader();
+        if (attached)
+            startThread (juce::Thread::Priority::low);
+    }
+
+    ~ReverbAnalyser() override
+    {
+        stopThread (1000);
+
+        if (attached)
+            tap.detachReader();
+    }
+
+    //==============================================================================
+    // Message thread
+
+    // True once per new set of images
+    bool takeNewFrame() { return new_frame.exchange (false); }
+
+    juce::Image getSpectrogram() const
+    {
+        const juce::ScopedLock lock (image_lock);
+        return spectrogram_front;
+    }
+
+    juce::Image getDecayCurve() const
+    {
+        const juce::ScopedLock lock (image_lock);
+        return decay_front;
+    }
+
+    // Seconds, or a negative value until a decay has been measured
+    float getRt60() const { return rt60.load(); }
+
+    // False when another editor's analyser was reading the tap first
+    bool isAttached() const { return attached; }
+
+private:
+    // Software images can be drawn into on any thread. Cleared RGB is black.
+    static juce::Image makeImage (int width, int height)
+    {
+        return juce::Image (juce::Image::RGB, width, height, true, juce::SoftwareImageType());
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            const int got = tap.pop (incoming_left + pending, incoming_right + pending, hop - pending);
+
+            // The newest hop goes at the end of the frame, mixed to mono
+            float* newest = frame + fft_size - hop;
+            for (int i = pending; i < pending + got; ++i)
+                newest[i] = 0.5f * (incoming_left[i] + incoming_right[i]);
+
+            pending += got;
+
+            if (pending < hop)
+            {
+                wait (10);
+                continue;
+            }
+
+            analyseFrame();
+            std::copy (frame + hop, frame + fft_size, frame.get());
+            pending = 0;
+        }
+    }
+
+    void analyseFrame()
+    {
+        const double sample_rate = juce::jmax (1.0, processor.getSampleRate());
+
+        // ENERGY AND DECAY
+
+        const float* newest = frame + fft_size - hop;
+        double energy = 0.0;
+        for (int i = 0; i < hop; ++i)
+            energy += newest[i] * newest[i];
+
+        const float level_db = juce::jmax (floor_db, (float) (10.0 * std::log10 (energy / hop + 1.0e-12)));
+        const int history_length = juce::jlimit (2, max_history, (int) std::ceil (decay_seconds * sample_rate / hop));
+
+        if (history_length != current_history_length)
+        {
+            current_history_length = history_length;
+            history_write = history_count = 0;
+        }
+
+        history[(size_t) history_write] = level_db;
+        history_write = (history_write + 1) % history_length;
+        history_count = juce::jmin (history_count + 1, history_length);
+
+        trackDecay (level_db, sample_rate);
+
+        // SPECTRUM
+
+        std::copy (frame.get(), frame + fft_size, fft_data.get());
+        std::fill (fft_data + fft_size, fft_data + 2 * fft_size, 0.0f);
+        window.multiplyWithWindowingTable (fft_data, (size_t) fft_size);
+        fft.performFrequencyOnlyForwardTransform (fft_data, true);
+
+        // Scroll one column and draw the newest at the right edge. Rows are log spaced from 20 Hz.
+        spectrogram.moveImageSection (0, 0, 1, 0, spectrogram_width - 1, spectrogram_height);
+
+        const double nyquist = sample_rate / 2.0;
+        const double amplitude_scale = 4.0 / fft_size;   // a full scale sine reads 0 dB through the Hann window
+
+        for (int y = 0; y < spectrogram_height; ++y)
+        {
+            const double proportion = 1.0 - (y + 0.5) / spectrogram_height;
+            const double frequency = 20.0 * std::pow (nyquist / 20.0, proportion);
+            const int bin = juce::jlimit (0, fft_size / 2, (int) std::round (frequency / sample_rate * fft_size));
+            const float db = juce::Decibels::gainToDecibels ((float) (fft_data[bin] * amplitude_scale), floor_db);
+
+            spectrogram.setPixelAt (spectrogram_width - 1, y, heatColour ((db - floor_db) / -floor_db));
+        }
+
+        // PUBLISH
+
+        // No faster than the editor repaints
+        const auto now = juce::Time::getMillisecondCounter();
+        if (now - last_publish < 30)
+            return;
+
+        last_publish = now;
+        drawDecay (history_length);
+
+        {
+            const juce::ScopedLock lock (image_lock);
+            spectrogram_front = spectrogram.createCopy();
+            decay_front = decay.createCopy();
+        }
+
+        new_frame = true;
+    }
+
+    // Watches for the envelope dropping away from a peak. Once it has gone
+    // from -5 to -25 dB below the peak without recovering, the slope of that
+    // stretch gives the RT60.
+    void trackDecay (float level_db, double sample_rate)
+    {
+        constexpr float start_db = -5.0f, end_db = -25.0f;
+        constexpr float min_peak_db = floor_db + 40.0f;
+
+        if (! in_decay)
+        {
+            if (level_db >= peak_db)
+                peak_db = level_db;
+            else if (level_db < peak_db + start_db)
+                in_decay = true;
+        }
+        else if (level_db > peak_db + start_db)
+        {
+            // Came back up, so this was not a free decay
+            in_decay = false;
+            peak_db = level_db;
+        }
+
+        if (! in_decay)
+        {
+            decay_points.clear();
+            return;
+        }
+
+        decay_points.push_back (level_db);
+
+        if (level_db >= peak_db + end_db)
+            return;
+
+        if (peak_db > min_peak_db && decay_points.size() >= 3)
+        {
+            // Least squares slope in dB per hop
+            const double n = (double) decay_points.size();
+            double sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_xy = 0.0;
+            for (size_t i = 0; i < decay_points.size(); ++i)
+            {
+                sum_x += (double) i;
+                sum_y += decay_points[i];
+                sum_xx += (double) i * (double) i;
+                sum_xy += (double) i * decay_points[i];
+            }
+
+            const double slope = (n * sum_xy - sum_x * sum_y) / (n * sum_xx - sum_x * sum_x);
+            if (slope < 0.0)
+                rt60 = (float) (-60.0 / slope * hop / sample_rate);
+        }
+
+        // Look for the next decay from here
+        in_decay = false;
+        peak_db = level_db;
+        decay_points.clear();
+    }
+
+    void drawDecay (int history_length)
+    {
+        juce::Graphics g (decay);
+        g.fillAll (juce::Colours::black);
+
+        // Grid lines every 20 dB
+        g.setColour (juce::Colours::darkgrey);
+        for (float db = -20.0f; db > floor_db; db -= 20.0f)
+            g.drawHorizontalLine (juce::roundToInt (db / floor_db * decay_height), 0.0f, (float) decay_width);
+
+        juce::Path path;
+        const int oldest = (history_write - history_count + history_length) % history_length;
+
+        for (int i = 0; i < history_count; ++i)
+        {
+            const float db = history[(size_t) ((oldest + i) % history_length)];
+            const float x = (float) decay_width * (float) (history_length - history_count + i) / (float) (history_length - 1);
+            const float y = db / floor_db * (float) decay_height;
+
+            if (i == 0)
+                path.startNewSubPath (x, y);
+            else
+                path.lineTo (x, y);
+        }
+
+        g.setColour (juce::Colours::lightblue);
+        g.strokePath (path, juce::PathStrokeType (1.5f));
+    }
+
+    // Black through blue and orange to yellow as the level goes from the floor to 0 dB
+    static juce::Colour heatColour (float proportion)
+    {
+        proportion = juce::jlimit (0.0f, 1.0f, proportion);
+        return juce::Colour::fromHSV (0.7f - 0.55f * proportion, 0.9f, proportion, 1.0f);
+    }
+
+    static constexpr int max_history = 4096;
+
+    AnalysisTap& tap;
+    juce::AudioProcessor& processor;
+    bool attached = false;
+
+    juce::dsp::FFT fft { fft_order };
+    juce::dsp::WindowingFunction<float> window { (size_t) fft_size, juce::dsp::WindowingFunction<float>::hann, false };
+
+    juce::HeapBlock<float> frame, fft_data, incoming_left, incoming_right;
+    int pending = 0;
+
+    std::array<float, max_history> history {};
+    int history_write = 0, history_count = 0, current_history_length = 0;
+
+    float peak_db = floor_db;
+    bool in_decay = false;
+    std::vector<float> decay_points;
+    std::atomic<float> rt60 { -1.0f };
+
+    juce::Image spectrogram, decay;
+    juce::uint32 last_publish = 0;
+
+    juce::CriticalSection image_lock;
+    juce::Image spectrogram_front, decay_front;
+    std::atomic<bool> new_frame { false };
+
+    JUCE_DECLARE_NON_COPYABLE (ReverbAnalyser)
+};
+
+//==============================================================================
+/** Spectrogram on the left, decay envelope and RT60 on the right. */
+class AnalyserView  : public juce::Component,
+                      private juce::Timer
+{
+public:
+    AnalyserView (AnalysisTap& tap, juce::AudioProcessor& processor)
+        : analyser (tap, processor)
+    {
+        setOpaque (true);
+        startTimerHz (30);
+    }
+
+    void paint (juce::Graphics& g) override
+    {
+        g.fillAll (juce::Colours::black);
+
+        auto area = getLocalBounds();
+        auto spectrum_area = area.removeFromLeft (area.getWidth() / 2).reduced (2);
+        auto decay_area = area.reduced (2);
+
+        g.drawImage (analyser.getSpectrogram(), spectrum_area.toFloat(), juce::RectanglePlacement::stretchToFit);
+        g.drawImage (analyser.getDecayCurve(), decay_area.toFloat(), juce::RectanglePlacement::stretchToFit);
+
+        g.setColour (juce::Colours::white);
+        g.setFont (juce::FontOptions (12.0f));
+        g.drawText ("Spectrogram", spectrum_area.reduced (4), juce::Justification::topLeft);
+
+        if (! analyser.isAttached())
+        {
+            g.drawText ("Analysis is shown in the other open editor", getLocalBounds(), juce::Justification::centred);
+            return;
+        }
+
+        const float rt60 = analyser.getRt60();
+        g.drawText (rt60 > 0.0f ? "RT60 " + juce::String (rt60, 2) + " s" : juce::String ("RT60 -"),
+                    decay_area.reduced (4), juce::Justification::topLeft);
+    }
+
+private:
+    void timerCallback() override
+    {
+        if (analyser.takeNewFrame() && isShowing())
+            repaint();
+    }
+
+    ReverbAnalyser analyser;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalyserView)
+};
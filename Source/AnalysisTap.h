@@ -0,0 +1,110 @@
+/*
+  ==============================================================================
+
+    AnalysisTap.h
+    Wait-free copy of the processor output for the editor's analysers.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    A stereo ring the audio thread copies its output into, drained by an
+    analysis thread. Pushing is an AbstractFifo reservation and two memcpys;
+    whatever does not fit is dropped, so the audio thread never waits. Until
+    a reader attaches, push returns straight away.
+
+    The FIFO has a single reader, so only one can be attached at a time. A
+    second editor on the same processor is refused rather than left to pop
+    from under the first.
+*/
+class AnalysisTap
+{
+public:
+    static constexpr int capacity = 1 << 15;
+
+    AnalysisTap()
+    {
+        for (auto& channel : channels)
+            channel.allocate ((size_t) capacity, true);
+    }
+
+    // Before the reader starts popping. False if another reader holds the
+    // tap, in which case this one must not pop. A fresh reader first throws
+    // away whatever was left over.
+    bool attachReader()
+    {
+        bool expected = false;
+        if (! has_reader.compare_exchange_strong (expected, true, std::memory_order_acq_rel))
+            return false;
+
+        discard();
+        active.store (true, std::memory_order_release);
+        return true;
+    }
+
+    // Once an attached reader has stopped popping
+    void detachReader()
+    {
+        active.store (false, std::memory_order_release);
+        has_reader.store (false, std::memory_order_release);
+    }
+
+    // Audio thread
+    void push (const float* left, const float* right, int numSamples) noexcept
+    {
+        if (! active.load (std::memory_order_acquire))
+            return;
+
+        const auto scope = fifo.write (numSamples);
+        copyIn (left, right, scope.startIndex1, scope.blockSize1, 0);
+        copyIn (left, right, scope.startIndex2, scope.blockSize2, scope.blockSize1);
+    }
+
+    // Reader thread. Returns the number of samples copied out.
+    int pop (float* left, float* right, int maxSamples) noexcept
+    {
+        const auto scope = fifo.read (maxSamples);
+        copyOut (left, right, scope.startIndex1, scope.blockSize1, 0);
+        copyOut (left, right, scope.startIndex2, scope.blockSize2, scope.blockSize1);
+        return scope.blockSize1 + scope.blockSize2;
+    }
+
+    int getNumReady() const noexcept { return fifo.getNumReady(); }
+
+private:
+    void discard() noexcept
+    {
+        const auto scope = fifo.read (fifo.getNumReady());
+        juce::ignoreUnused (scope);
+    }
+
+    void copyIn (const float* left, const float* right, int start, int size, int offset) noexcept
+    {
+        if (size > 0)
+        {
+            std::copy (left + offset, left + offset + size, channels[0] + start);
+            std::copy (right + offset, right + offset + size, channels[1] + start);
+        }
+    }
+
+    void copyOut (float* left, float* right, int start, int size, int offset) const noexcept
+    {
+        if (size > 0)
+        {
+            std::copy (channels[0] + start, channels[0] + start + size, left + offset);
+            std::copy (channels[1] + start, channels[1] + start + size, right + offset);
+        }
+    }
+
+    juce::AbstractFifo fifo { capacity };
+    std::array<juce::HeapBlock<float>, 2> channels;
+    std::atomic<bool> active { false };
+    std::atomic<bool> has_reader { false };
+
+    JUCE_DECLARE_NON_COPYABLE (AnalysisTap)
+};
@@ -0,0 +1,123 @@
+/*
+  ==============================================================================
+
+    CpuBreakdownView.h
+    Live per-stage CPU meter for the editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "StageProfiler.h"
+
+//==============================================================================
+/**
+    One row per profiled stage: a bar for its share of the block time and its
+    p50 / p99 / max cycles per sample, with the deadline misses underneath.
+    Polls the profiler ten times a second on the message thread.
+*/
+class CpuBreakdownView  : public juce::Component,
+                          private juce::Timer
+{
+public:
+    explicit CpuBreakdownView (StageProfiler& p)
+        : profiler (p)
+    {
+        reset_button.onClick = [this] { profiler.reset(); repaint(); };
+        addAndMakeVisible (reset_button);
+
+        export_button.onClick = [this] { exportCsv(); };
+        addAndMakeVisible (export_button);
+
+        if (StageProfiler::enabled)
+            startTimerHz (10);
+    }
+
+    void paint (juce::Graphics& g) override
+    {
+        auto area = getLocalBounds().withTrimmedTop (button_height + 4);
+        g.setFont (juce::FontOptions (12.0f));
+        g.setColour (juce::Colours::white);
+
+        if (! StageProfiler::enabled)
+        {
+            g.drawFittedText ("Profiling is compiled out (REVERB_PROFILING=0)", area, juce::Justification::centred, 1);
+            return;
+        }
+
+        const int num_stages = profiler.getNumStages();
+        const int row_height = juce::jmax (1, (area.getHeight() - row_gap) / (num_stages + 1));
+
+        for (int stage = 0; stage < num_stages; ++stage)
+        {
+            const auto stats = profiler.getStageStats (stage);
+            auto row = area.removeFromTop (row_height);
+
+            g.setColour (juce::Colours::white);
+            g.drawText (stats.name, row.removeFromLeft (label_width), juce::Justification::centredLeft);
+
+            auto bar = row.removeFromLeft (bar_width).reduced (0, 3);
+            g.setColour (juce::Colours::darkgrey);
+            g.fillRect (bar);
+            g.setColour (juce::Colours::orange);
+            g.fillRect (bar.withWidth (juce::roundToInt (bar.getWidth() * juce::jlimit (0.0, 1.0, stats.share))));
+
+            g.setColour (juce::Colours::white);
+            g.drawText (juce::String (stats.p50, 1) + " / " + juce::String (stats.p99, 1) + " / "
+                            + juce::String (stats.max, 1),
+                        row.reduced (4, 0), juce::Justification::centredRight);
+        }
+
+        const auto block = profiler.getBlockStats();
+        g.drawText ("cycles/sample p50 / p99 / max    deadline misses " + juce::String (block.deadline_misses)
+                        + " of " + juce::String (block.blocks) + ", worst block "
+                        + juce::String (100.0f * block.worst_load, 1) + "%",
+                    area.withTrimmedTop (row_gap), juce::Justification::centredLeft);
+    }
+
+    void resized() override
+    {
+        auto buttons = getLocalBounds().removeFromTop (button_height);
+        export_button.setBounds (buttons.removeFromRight (90));
+        buttons.removeFromRight (4);
+        reset_button.setBounds (buttons.removeFromRight (60));
+    }
+
+private:
+    void timerCallback() override
+    {
+        if (isShowing())
+            repaint();
+    }
+
+    void exportCsv()
+    {
+        chooser = std::make_unique<juce::FileChooser> ("Export CPU profile",
+                                                       juce::File::getSpecialLocation (juce::File::userDocumentsDirectory)
+                                                           .getChildFile ("ReverbProfile.csv"),
+                                                       "*.csv");
+
+        const auto flags = juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                         | juce::FileBrowserComponent::warnAboutOverwriting;
+
+        chooser->launchAsync (flags, [this] (const juce::FileChooser& fc)
+        {
+            const auto file = fc.getResult();
+            if (file != juce::File())
+                file.replaceWithText (profiler.toCsv());
+        });
+    }
+
+    static constexpr int button_height = 22;
+    static constexpr int label_width = 80;
+    static constexpr int bar_width = 120;
+    static constexpr int row_gap = 4;
+
+    StageProfiler& profiler;
+    juce::TextButton reset_button { "Reset" }, export_button { "Export CSV" };
+    std::unique_ptr<juce::FileChooser> chooser;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CpuBreakdownView)
+};
@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    DelayArena.h
+    One block of memory holding every delay line of the reverb network.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_MAC || JUCE_LINUX || JUCE_BSD
+ #include <sys/mman.h>
+#endif
+
+//==============================================================================
+/**
+    Contiguous storage for a set of delay lines, each given exactly the
+    samples it needs and starting on its own cache line. Sample is the type
+    the lines store, float or HalfFloat.
+
+    prepare() allocates on the message thread and writes every page, so the
+    operating system has backed all of it with memory before the audio thread
+    first touches a long delay. Where the platform allows it the pages are
+    also locked, so they are never paged out while the plugin runs. Locking
+    is best effort: hosts often limit how much a process may lock, and the
+    arena works the same without it.
+*/
+template <typename Sample>
+class DelayArena
+{
+public:
+    DelayArena() = default;
+    ~DelayArena() { release(); }
+
+    // Samples a line of numSamples takes, rounded up so the next one starts on a new cache line
+    static int getFootprint (int numSamples)
+    {
+        return (numSamples + samples_per_line - 1) / samples_per_line * samples_per_line;
+    }
+
+    // Room for totalSamples, the sum of the footprints of the lines it will
+    // hold. Preparing again for the same total keeps the allocation and just zeroes it.
+    void prepare (int totalSamples)
+    {
+        if (base != nullptr && totalSamples == total_samples)
+        {
+            clear();
+            return;
+        }
+
+        release();
+
+        total_samples = totalSamples;
+        storage.allocate ((size_t) (total_samples + samples_per_line), false);
+
+        auto address = reinterpret_cast<std::uintptr_t> (storage.get());
+        base = reinterpret_cast<Sample*> ((address + cache_line_bytes - 1) & ~(std::uintptr_t) (cache_line_bytes - 1));
+
+        // Writing the zeros is what makes the pages resident; a zeroing
+        // allocation may just map them lazily
+        clear();
+
+       #if JUCE_MAC || JUCE_LINUX || JUCE_BSD
+        locked = mlock (base, getBytes()) == 0;
+       #endif
+    }
+
+    void release()
+    {
+       #if JUCE_MAC || JUCE_LINUX || JUCE_BSD
+        if (locked)
+            munlock (base, getBytes());
+       #endif
+
+        locked = false;
+        storage.free();
+        base = nullptr;
+        total_samples = 0;
+    }
+
+    void clear()
+    {
+        if (base != nullptr)
+            juce::zeromem (base, getBytes());
+    }
+
+    // Zeroes numBytes from byteOffset on, for clearing a piece at a time
+    void clear (size_t byteOffset, size_t numBytes)
+    {
+        jassert (byteOffset + numBytes <= getBytes());
+
+        if (base != nullptr)
+            juce::zeromem (reinterpret_cast<char*> (base) + byteOffset, numBytes);
+    }
+
+    // The line at offset samples in, where offset is a sum of footprints
+    Sample* get (int offset) const
+    {
+        jassert (offset % samples_per_line == 0 && offset < total_samples);
+        return base + offset;
+    }
+
+    size_t getBytes() const { return (size_t) total_samples * sizeof (Sample); }
+
+private:
+    static constexpr int cache_line_bytes = 64;
+    static constexpr int samples_per_line = cache_line_bytes / (int) sizeof (Sample);
+
+    juce::HeapBlock<Sample> storage;
+    Sample* base = nullptr;
+    int total_samples = 0;
+    bool locked = false;
+
+    JUCE_DECLARE_NON_COPYABLE (DelayArena)
+};
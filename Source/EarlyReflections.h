@@ -0,0 +1,160 @@
+/*
+  ==============================================================================
+
+    EarlyReflections.h
+    Sparse multi-tap early reflections, all read from one ring buffer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DelayLine.h"
+
+//==============================================================================
+/**
+    The first reflections of a room, as a sparse table of taps on one shared
+    ring buffer.
+
+    The wet input goes into the ring once per block, summed to mono. Each tap
+    adds a scaled copy of it, delayed by the tap's time, to one of the two
+    outputs. A tap is one contiguous span of the ring per block, two at the
+    wrap, added with a vectorised multiply-add. So the cost is taps x block
+    length however late the reflections are, and only the ring's memory
+    grows with the longest one.
+
+    Tap times are ratios of the room size, like every delay in the network,
+    so Size moves the reflections along with the tail. A new size glides the
+    taps there, each read while it moves with DelayLine's gliding reads.
+*/
+class EarlyReflections
+{
+public:
+    struct Tap
+    {
+        float seconds;   // at size 1
+        float gain;
+        int channel;     // 0 left, 1 right
+    };
+
+    // Moorer's 18 tap pattern of a medium hall, sides alternating so that
+    // reflections close in time land on opposite sides
+    static constexpr int num_taps = 18;
+    static constexpr std::array<Tap, num_taps> taps { {
+        { 0.0043f, 0.841f, 0 }, { 0.0215f, 0.504f, 1 }, { 0.0225f, 0.491f, 0 },
+        { 0.0268f, 0.379f, 1 }, { 0.0270f, 0.380f, 0 }, { 0.0298f, 0.346f, 1 },
+        { 0.0458f, 0.289f, 0 }, { 0.0485f, 0.272f, 1 }, { 0.0572f, 0.192f, 0 },
+        { 0.0587f, 0.193f, 1 }, { 0.0595f, 0.217f, 0 }, { 0.0612f, 0.181f, 1 },
+        { 0.0707f, 0.180f, 0 }, { 0.0708f, 0.181f, 1 }, { 0.0726f, 0.176f, 0 },
+        { 0.0741f, 0.142f, 1 }, { 0.0753f, 0.167f, 0 }, { 0.0797f, 0.134f, 1 }
+    } };
+
+    static constexpr float longest_seconds = 0.0797f;
+
+    EarlyReflections() = default;
+
+    // Message thread. Sizes the ring for the latest tap at maxSize, plus
+    // extraDelaySamples that addTo() can hold every tap back by.
+    void prepare (double sampleRate, float maxSize, int extraDelaySamples, int maxBlockSize)
+    {
+        sample_rate = sampleRate;
+        max_extra_delay = extraDelaySamples;
+
+        ring.prepare (delaySamples (longest_seconds, maxSize) + extraDelaySamples, maxBlockSize);
+        mono.allocate ((size_t) maxBlockSize, true);
+        max_block_size = maxBlockSize;
+    }
+
+    void release()
+    {
+        ring.release();
+        mono.free();
+        max_block_size = 0;
+    }
+
+    // Silences the ring, with every tap starting straight from its time at the current size
+    void clear()
+    {
+        ring.clear();
+
+        for (int i = 0; i < num_taps; ++i)
+            tap_starts[(size_t) i] = tap_ends[(size_t) i] = static_cast<float> (tap_samples[(size_t) i]);
+    }
+
+    // Only between blocks. The taps glide to their new times from the next push().
+    void setSize (float size)
+    {
+        for (int i = 0; i < num_taps; ++i)
+            tap_samples[(size_t) i] = delaySamples (taps[(size_t) i].seconds, size);
+    }
+
+    // Appends a block of the stereo input to the ring, and moves each tap on
+    // over it towards its time
+    void push (const float* left, const float* right, int numSamples)
+    {
+        jassert (numSamples <= max_block_size);
+
+        juce::FloatVectorOperations::add (mono.get(), left, right, numSamples);
+        ring.write (mono.get(), numSamples);
+
+        for (int i = 0; i < num_taps; ++i)
+        {
+            tap_starts[(size_t) i] = tap_ends[(size_t) i];
+            tap_ends[(size_t) i] = DelayLine::glideTowards (tap_ends[(size_t) i], static_cast<float> (tap_samples[(size_t) i]), numSamples);
+        }
+    }
+
+    // Adds every tap of the last pushed block, scaled by gain and delayed by
+    // extraDelaySamples on top of the tap times, to left and right
+    void addTo (float* left, float* right, int numSamples, float gain, int extraDelaySamples) const
+    {
+        jassert (extraDelaySamples <= max_extra_delay);
+
+        // The ring holds left + right
+        const float input_gain = 0.5f * gain;
+        float* const outputs[] = { left, right };
+
+        for (int i = 0; i < num_taps; ++i)
+        {
+            const auto& tap = taps[(size_t) i];
+            const float start = tap_starts[(size_t) i], end = tap_ends[(size_t) i];
+
+            // A tap that has stopped is where it was heading, a whole number of samples
+            if (start == end)
+                ring.addTo (outputs[tap.channel], numSamples, tap_samples[(size_t) i] + extraDelaySamples, input_gain * tap.gain);
+            else
+                ring.addGliding (outputs[tap.channel], numSamples, start + (float) extraDelaySamples,
+                                 end + (float) extraDelaySamples, input_gain * tap.gain);
+        }
+    }
+
+    // The latest tap at the current size, or further while one is still gliding there, in samples
+    int getLongestDelay() const
+    {
+        int longest = 0;
+        for (int i = 0; i < num_taps; ++i)
+            longest = juce::jmax (longest, tap_samples[(size_t) i], static_cast<int> (std::ceil (tap_ends[(size_t) i])));
+
+        return longest;
+    }
+
+private:
+    int delaySamples (float seconds, float size) const
+    {
+        return static_cast<int> (std::round (seconds * size * sample_rate));
+    }
+
+    double sample_rate = 44100.0;
+    int max_block_size = 0;
+    int max_extra_delay = 0;
+
+    DelayLine ring;
+    juce::HeapBlock<float> mono;
+    std::array<int, num_taps> tap_samples {};
+
+    // Where each tap's read started and ended over the last pushed block
+    std::array<float, num_taps> tap_starts {}, tap_ends {};
+
+    JUCE_DECLARE_NON_COPYABLE (EarlyReflections)
+};
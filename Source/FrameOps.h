@@ -0,0 +1,538 @@
+/*
+  ==============================================================================
+
+    FrameOps.h
+    Vector kernels for the interleaved reverb network.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SimdLevel.h"
+
+// Largest network the frame kernels are instantiated for, the dense tier's
+// 16 channels. Wider frames would need their own check against the scalar level.
+constexpr int max_frame_lanes = 16;
+
+// One frame worth of per lane values (polarity signs, gains, filter coefficients and state)
+struct alignas (16) FrameConstants
+{
+    float lane[max_frame_lanes];
+};
+
+//==============================================================================
+// The registers the kernels are written against, one per width. Each has
+// the same handful of operations: loads and stores of whole frames or parts
+// of them, lane-wise arithmetic, a horizontal sum, and swap<S>(), which
+// exchanges every lane i with lane i ^ S for the in-register butterflies.
+
+#if JUCE_USE_SIMD
+// Four floats, SSE2 or NEON, through juce::dsp::SIMDRegister. Loads and
+// stores are aligned, so the frame arrays must start on a 16 byte boundary.
+struct FrameVector128
+{
+    using Register = juce::dsp::SIMDRegister<float>;
+    static_assert (Register::SIMDNumElements == 4, "FrameVector128 assumes 4 float registers");
+
+    static constexpr int width = 4;
+    Register value;
+
+    static FrameVector128 load (const float* p) { return { Register::fromRawArray (p) }; }
+    static FrameVector128 expand (float x) { return { Register::expand (x) }; }
+    void store (float* p) const { value.copyToRawArray (p); }
+
+    friend FrameVector128 operator+ (FrameVector128 a, FrameVector128 b) { return { a.value + b.value }; }
+    friend FrameVector128 operator- (FrameVector128 a, FrameVector128 b) { return { a.value - b.value }; }
+    friend FrameVector128 operator* (FrameVector128 a, FrameVector128 b) { return { a.value * b.value }; }
+
+    // a * b + c
+    static FrameVector128 mulAdd (FrameVector128 a, FrameVector128 b, FrameVector128 c) { return { a.value * b.value + c.value }; }
+
+    float sum() const { return value.sum(); }
+
+    template <int Stride>
+    FrameVector128 swap() const
+    {
+        static_assert (Stride == 1 || Stride == 2, "Four lanes swap in pairs or halves");
+
+       #if JUCE_INTEL
+        constexpr int order = Stride == 2 ? _MM_SHUFFLE (1, 0, 3, 2) : _MM_SHUFFLE (2, 3, 0, 1);
+        return { Register::fromNative (_mm_shuffle_ps (value.value, value.value, order)) };
+       #elif JUCE_ARM
+        if constexpr (Stride == 2)
+            return { Register::fromNative (vextq_f32 (value.value, value.value, 2)) };
+        else
+            return { Register::fromNative (vrev64q_f32 (value.value)) };
+       #endif
+    }
+};
+#endif
+
+#if JUCE_INTEL && JUCE_USE_SIMD
+// Eight floats in an AVX register. Only use it in code compiled for
+// SimdLevel::avx2 or above. Loads and stores are unaligned, which costs
+// nothing on data that happens to be aligned. Operands go by reference, as
+// the FrameOps kernels calling these have no AVX target of their own and an
+// AVX value passed by value would change the calling convention.
+struct FrameVector256
+{
+    static constexpr int width = 8;
+    __m256 value;
+
+    REVERB_AVX2_FUNCTION static FrameVector256 load (const float* p) { return { _mm256_loadu_ps (p) }; }
+    REVERB_AVX2_FUNCTION static FrameVector256 expand (float x) { return { _mm256_set1_ps (x) }; }
+    REVERB_AVX2_FUNCTION void store (float* p) const { _mm256_storeu_ps (p, value); }
+
+    REVERB_AVX2_FUNCTION friend FrameVector256 operator+ (const FrameVector256& a, const FrameVector256& b) { return { _mm256_add_ps (a.value, b.value) }; }
+    REVERB_AVX2_FUNCTION friend FrameVector256 operator- (const FrameVector256& a, const FrameVector256& b) { return { _mm256_sub_ps (a.value, b.value) }; }
+    REVERB_AVX2_FUNCTION friend FrameVector256 operator* (const FrameVector256& a, const FrameVector256& b) { return { _mm256_mul_ps (a.value, b.value) }; }
+
+    REVERB_AVX2_FUNCTION static FrameVector256 mulAdd (const FrameVector256& a, const FrameVector256& b, const FrameVector256& c)
+    {
+        return { _mm256_fmadd_ps (a.value, b.value, c.value) };
+    }
+
+    REVERB_AVX2_FUNCTION float sum() const
+    {
+        auto x = _mm_add_ps (_mm256_castps256_ps128 (value), _mm256_extractf128_ps (value, 1));
+        x = _mm_add_ps (x, _mm_shuffle_ps (x, x, _MM_SHUFFLE (1, 0, 3, 2)));
+        x = _mm_add_ps (x, _mm_shuffle_ps (x, x, _MM_SHUFFLE (2, 3, 0, 1)));
+        return _mm_cvtss_f32 (x);
+    }
+
+    template <int Stride>
+    REVERB_AVX2_FUNCTION FrameVector256 swap() const
+    {
+        static_assert (Stride == 1 || Stride == 2 || Stride == 4, "Eight lanes swap by 1, 2 or 4");
+
+        if constexpr (Stride == 4)
+            return { _mm256_permute2f128_ps (value, value, 1) };
+        else if constexpr (Stride == 2)
+            return { _mm256_permute_ps (value, _MM_SHUFFLE (1, 0, 3, 2)) };
+        else
+            return { _mm256_permute_ps (value, _MM_SHUFFLE (2, 3, 0, 1)) };
+    }
+};
+
+// Sixteen floats in an AVX-512 register. Only use it in code compiled for SimdLevel::avx512.
+struct FrameVector512
+{
+    static constexpr int width = 16;
+    __m512 value;
+
+    REVERB_AVX512_FUNCTION static FrameVector512 load (const float* p) { return { _mm512_loadu_ps (p) }; }
+    REVERB_AVX512_FUNCTION static FrameVector512 expand (float x) { return { _mm512_set1_ps (x) }; }
+    REVERB_AVX512_FUNCTION void store (float* p) const { _mm512_storeu_ps (p, value); }
+
+    REVERB_AVX512_FUNCTION friend FrameVector512 operator+ (const FrameVector512& a, const FrameVector512& b) { return { _mm512_add_ps (a.value, b.value) }; }
+    REVERB_AVX512_FUNCTION friend FrameVector512 operator- (const FrameVector512& a, const FrameVector512& b) { return { _mm512_sub_ps (a.value, b.value) }; }
+    REVERB_AVX512_FUNCTION friend FrameVector512 operator* (const FrameVector512& a, const FrameVector512& b) { return { _mm512_mul_ps (a.value, b.value) }; }
+
+    REVERB_AVX512_FUNCTION static FrameVector512 mulAdd (const FrameVector512& a, const FrameVector512& b, const FrameVector512& c)
+    {
+        return { _mm512_fmadd_ps (a.value, b.value, c.value) };
+    }
+
+    // The masked forms with every lane set compile to the same instructions
+    // as the plain ones. GCC 12 builds those on an uninitialised register,
+    // which -Wmaybe-uninitialized reports in every caller.
+    static constexpr __mmask16 all_lanes = 0xffff;
+
+    // Halves, then as FrameVector256::sum, the same order as _mm512_reduce_add_ps
+    REVERB_AVX512_FUNCTION float sum() const
+    {
+        const auto whole = _mm512_castps_pd (value);
+        const auto low = _mm256_castpd_ps (_mm512_mask_extractf64x4_pd (_mm256_setzero_pd(), 0xff, whole, 0));
+        const auto high = _mm256_castpd_ps (_mm512_mask_extractf64x4_pd (_mm256_setzero_pd(), 0xff, whole, 1));
+        return FrameVector256 { _mm256_add_ps (high, low) }.sum();
+    }
+
+    template <int Stride>
+    REVERB_AVX512_FUNCTION FrameVector512 swap() const
+    {
+        static_assert (Stride == 1 || Stride == 2 || Stride == 4 || Stride == 8, "Sixteen lanes swap by 1, 2, 4 or 8");
+
+        if constexpr (Stride == 8)
+            return { _mm512_mask_shuffle_f32x4 (value, all_lanes, value, value, _MM_SHUFFLE (1, 0, 3, 2)) };
+        else if constexpr (Stride == 4)
+            return { _mm512_mask_shuffle_f32x4 (value, all_lanes, value, value, _MM_SHUFFLE (2, 3, 0, 1)) };
+        else if constexpr (Stride == 2)
+            return { _mm512_mask_permute_ps (value, all_lanes, value, _MM_SHUFFLE (1, 0, 3, 2)) };
+        else
+            return { _mm512_mask_permute_ps (value, all_lanes, value, _MM_SHUFFLE (2, 3, 0, 1)) };
+    }
+};
+#endif
+
+// The register FrameOps<N, Level> works in: Level's widest, but no wider
+// than a frame. void for the scalar level, which uses none.
+template <SimdLevel Level, int N>
+struct FrameVectorFor
+{
+    static constexpr int width = std::min (getSimdWidth (Level), N);
+
+    using Type =
+       #if JUCE_INTEL && JUCE_USE_SIMD
+        std::conditional_t<width == 16, FrameVector512,
+        std::conditional_t<width == 8, FrameVector256,
+        std::conditional_t<width == 4, FrameVector128, void>>>;
+       #elif JUCE_USE_SIMD
+        std::conditional_t<width == 4, FrameVector128, void>;
+       #else
+        void;
+       #endif
+};
+
+//==============================================================================
+/**
+    Kernels over interleaved frames, where one frame holds one sample of each
+    of the N network channels (lane c = channel c).
+
+    N is a compile-time power of two from 4 to 16, so every per-frame loop
+    below has a constant trip count and unrolls into N / W register
+    operations, with W the width of Level's registers: 4 (SSE2, NEON), 8
+    (AVX2) or 16 (AVX-512). Mixing, polarity and gain are a handful of
+    register operations per sample instead of a gather across N separate
+    channel pointers. The scalar level is the plain per-lane reference.
+
+    The AVX levels must run inside a SimdRegion of their level (the network
+    calls every kernel from one). Frame arrays must start on a 16 byte
+    boundary; the scratch arena hands out cache line aligned blocks.
+*/
+template <int N, SimdLevel Level>
+struct FrameOps
+{
+    static_assert (N >= 4 && N <= max_frame_lanes && (N & (N - 1)) == 0,
+                   "Frame lane counts must be a power of two from 4 to 16");
+
+    static constexpr int lanes = N;
+
+    // Input matrix (planar -> interleaved):
+    // frames[i] = left[i] * leftGains + right[i] * rightGains, lane by lane
+    static void inject (float* frames, const float* left, const float* right, int numFrames,
+                        const FrameConstants& leftGains, const FrameConstants& rightGains)
+    {
+        if constexpr (vectorised)
+        {
+            Vector left_gain[num_registers], right_gain[num_registers];
+            for (int r = 0; r < num_registers; ++r)
+            {
+                left_gain[r] = Vector::load (leftGains.lane + r * width);
+                right_gain[r] = Vector::load (rightGains.lane + r * width);
+            }
+
+            for (int i = 0; i < numFrames; ++i)
+            {
+                const auto in_left = Vector::expand (left[i]);
+                const auto in_right = Vector::expand (right[i]);
+                for (int r = 0; r < num_registers; ++r)
+                    Vector::mulAdd (in_left, left_gain[r], in_right * right_gain[r]).store (frames + i * N + r * width);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < numFrames; ++i)
+                for (int c = 0; c < N; ++c)
+                    frames[i * N + c] = left[i] * leftGains.lane[c] + right[i] * rightGains.lane[c];
+        }
+    }
+
+    // Output matrix (interleaved -> planar):
+    // left[i] += dot (frames[i], leftWeights), right[i] += dot (frames[i], rightWeights)
+    static void decode (float* left, float* right, const float* frames, int numFrames,
+                        const FrameConstants& leftWeights, const FrameConstants& rightWeights)
+    {
+        if constexpr (vectorised)
+        {
+            Vector left_weight[num_registers], right_weight[num_registers];
+            for (int r = 0; r < num_registers; ++r)
+            {
+                left_weight[r] = Vector::load (leftWeights.lane + r * width);
+                right_weight[r] = Vector::load (rightWeights.lane + r * width);
+            }
+
+            for (int i = 0; i < numFrames; ++i)
+            {
+                auto x = Vector::load (frames + i * N);
+                auto left_sum = x * left_weight[0];
+                auto right_sum = x * right_weight[0];
+
+                for (int r = 1; r < num_registers; ++r)
+                {
+                    x = Vector::load (frames + i * N + r * width);
+                    left_sum = Vector::mulAdd (x, left_weight[r], left_sum);
+                    right_sum = Vector::mulAdd (x, right_weight[r], right_sum);
+                }
+
+                left[i] += left_sum.sum();
+                right[i] += right_sum.sum();
+            }
+        }
+        else
+        {
+            for (int i = 0; i < numFrames; ++i)
+            {
+                float left_sum = 0.0f, right_sum = 0.0f;
+                for (int c = 0; c < N; ++c)
+                {
+                    left_sum += frames[i * N + c] * leftWeights.lane[c];
+                    right_sum += frames[i * N + c] * rightWeights.lane[c];
+                }
+
+                left[i] += left_sum;
+                right[i] += right_sum;
+            }
+        }
+    }
+
+    // Householder reflection about the all-ones vector, O(N) per frame:
+    // frames = frames - (2 / N) * (sum of lanes), in place
+    static void householder (float* frames, int numFrames)
+    {
+        constexpr float coefficient = 2.0f / (float) N;
+
+        if constexpr (vectorised)
+        {
+            for (int i = 0; i < numFrames; ++i)
+            {
+                float* frame = frames + i * N;
+
+                Vector x[num_registers];
+                for (int r = 0; r < num_registers; ++r)
+                    x[r] = Vector::load (frame + r * width);
+
+                auto sum = x[0];
+                for (int r = 1; r < num_registers; ++r)
+                    sum = sum + x[r];
+
+                const auto term = Vector::expand (coefficient * sum.sum());
+                for (int r = 0; r < num_registers; ++r)
+                    (x[r] - term).store (frame + r * width);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < numFrames; ++i)
+            {
+                float* frame = frames + i * N;
+
+                float sum = 0.0f;
+                for (int c = 0; c < N; ++c)
+                    sum += frame[c];
+
+                for (int c = 0; c < N; ++c)
+                    frame[c] -= coefficient * sum;
+            }
+        }
+    }
+
+    // Fast Walsh-Hadamard transform, O(N log N) per frame, blended with the input:
+    // frames = amount * H_N * (frames * signs) / sqrt(N) + (1 - amount) * frames, in place,
+    // with H_N the Sylvester Hadamard matrix. amount = 1 is the plain transform.
+    static void hadamard (float* frames, int numFrames, const FrameConstants& signs, float amount = 1.0f)
+    {
+        const float scale = amount / std::sqrt ((float) N);
+        const float dry = 1.0f - amount;
+
+        if constexpr (vectorised)
+        {
+            Vector sign[num_registers];
+            for (int r = 0; r < num_registers; ++r)
+                sign[r] = Vector::load (signs.lane + r * width) * Vector::expand (scale);
+
+            const auto dry_gain = Vector::expand (dry);
+
+            for (int i = 0; i < numFrames; ++i)
+            {
+                float* frame = frames + i * N;
+
+                Vector input[num_registers], x[num_registers];
+                for (int r = 0; r < num_registers; ++r)
+                {
+                    input[r] = Vector::load (frame + r * width);
+                    x[r] = input[r] * sign[r];
+                }
+
+                // Butterflies between whole registers (lane strides width .. N / 2)
+                for (int stride = 1; stride < num_registers; stride *= 2)
+                    for (int r = 0; r < num_registers; ++r)
+                        if ((r & stride) == 0)
+                        {
+                            const auto a = x[r];
+                            const auto b = x[r + stride];
+                            x[r] = a + b;
+                            x[r + stride] = a - b;
+                        }
+
+                // Then the stages within each register (lane strides width / 2 .. 1)
+                for (int r = 0; r < num_registers; ++r)
+                {
+                    hadamardInRegister<width / 2> (x[r]);
+                    Vector::mulAdd (input[r], dry_gain, x[r]).store (frame + r * width);
+                }
+            }
+        }
+        else
+        {
+            float input[N];
+            for (int i = 0; i < numFrames; ++i)
+            {
+                float* frame = frames + i * N;
+                for (int c = 0; c < N; ++c)
+                {
+                    input[c] = frame[c];
+                    frame[c] *= signs.lane[c] * scale;
+                }
+
+                for (int stride = 1; stride < N; stride *= 2)
+                    for (int c = 0; c < N; ++c)
+                        if ((c & stride) == 0)
+                        {
+                            const float a = frame[c];
+                            const float b = frame[c + stride];
+                            frame[c] = a + b;
+                            frame[c + stride] = a - b;
+                        }
+
+                for (int c = 0; c < N; ++c)
+                    frame[c] += input[c] * dry;
+            }
+        }
+    }
+
+    // One-pole filter on every lane, in place, with per lane coefficients:
+    // y[i] = gains * x[i] + poles * y[i - 1]. state holds each lane's last
+    // output between calls. A lane with gain 1 and pole 0 passes unchanged.
+    static void onePole (float* frames, int numFrames, const FrameConstants& gains,
+                         const FrameConstants& poles, FrameConstants& state)
+    {
+        if constexpr (vectorised)
+        {
+            Vector gain[num_registers], pole[num_registers], y[num_registers];
+            for (int r = 0; r < num_registers; ++r)
+            {
+                gain[r] = Vector::load (gains.lane + r * width);
+                pole[r] = Vector::load (poles.lane + r * width);
+                y[r] = Vector::load (state.lane + r * width);
+            }
+
+            for (int i = 0; i < numFrames; ++i)
+            {
+                for (int r = 0; r < num_registers; ++r)
+                {
+                    y[r] = Vector::mulAdd (Vector::load (frames + i * N + r * width), gain[r], y[r] * pole[r]);
+                    y[r].store (frames + i * N + r * width);
+                }
+            }
+
+            for (int r = 0; r < num_registers; ++r)
+                y[r].store (state.lane + r * width);
+        }
+        else
+        {
+            for (int i = 0; i < numFrames; ++i)
+            {
+                for (int c = 0; c < N; ++c)
+                {
+                    float& x = frames[i * N + c];
+                    x = x * gains.lane[c] + state.lane[c] * poles.lane[c];
+                    state.lane[c] = x;
+                }
+            }
+        }
+    }
+
+    // Cubic Lagrange interpolation of every lane at once, from a window of
+    // numFrames + 3 frames (DelayLine::readWindow). Frame i comes from window
+    // frames i .. i + 3, at a fraction past frame i + 1 that starts at
+    // fractions and moves by steps every frame, lane by lane. Farrow form.
+    static void interpolate (float* frames, const float* window, const FrameConstants& fractions,
+                             const FrameConstants& steps, int numFrames)
+    {
+        if constexpr (vectorised)
+        {
+            const auto half = Vector::expand (0.5f);
+            const auto sixth = Vector::expand (1.0f / 6.0f);
+
+            // One register of lanes at a time, sliding along the window so each
+            // frame loads only its newest tap
+            for (int r = 0; r < num_registers; ++r)
+            {
+                auto f = Vector::load (fractions.lane + r * width);
+                const auto step = Vector::load (steps.lane + r * width);
+
+                auto xm1 = Vector::load (window + r * width);
+                auto x0 = Vector::load (window + N + r * width);
+                auto x1 = Vector::load (window + 2 * N + r * width);
+
+                for (int i = 0; i < numFrames; ++i)
+                {
+                    const auto x2 = Vector::load (window + (i + 3) * N + r * width);
+
+                    const auto c2 = (xm1 + x1) * half - x0;
+                    const auto c3 = Vector::mulAdd (x2 - xm1, sixth, (x0 - x1) * half);
+                    const auto c1 = x1 - x0 - c2 - c3;
+                    Vector::mulAdd (Vector::mulAdd (Vector::mulAdd (c3, f, c2), f, c1), f, x0).store (frames + i * N + r * width);
+
+                    f = f + step;
+                    xm1 = x0;
+                    x0 = x1;
+                    x1 = x2;
+                }
+            }
+        }
+        else
+        {
+            for (int i = 0; i < numFrames; ++i)
+            {
+                const float* taps = window + i * N;
+
+                for (int c = 0; c < N; ++c)
+                {
+                    const float xm1 = taps[c], x0 = taps[N + c], x1 = taps[2 * N + c], x2 = taps[3 * N + c];
+                    const float f = fractions.lane[c] + steps.lane[c] * (float) i;
+
+                    const float c2 = (xm1 + x1) * 0.5f - x0;
+                    const float c3 = (x2 - xm1) * (1.0f / 6.0f) + (x0 - x1) * 0.5f;
+                    const float c1 = x1 - x0 - c2 - c3;
+                    frames[i * N + c] = ((c3 * f + c2) * f + c1) * f + x0;
+                }
+            }
+        }
+    }
+
+private:
+    using Vector = typename FrameVectorFor<Level, N>::Type;
+
+    static constexpr bool vectorised = ! std::is_void_v<Vector>;
+    static constexpr int width = FrameVectorFor<Level, N>::width;
+    static constexpr int num_registers = N / width;
+
+    // The butterflies within one register, from lane stride Stride down to 1:
+    // each lane i becomes x[i] + x[i ^ s] where bit s of i is clear, and
+    // x[i ^ s] - x[i] where it is set. This has no target attribute of its
+    // own, so the register goes by reference: an AVX value passed or
+    // returned by value would change the calling convention.
+    template <int Stride, typename Register>
+    static void hadamardInRegister (Register& x)
+    {
+        if constexpr (Stride > 0)
+        {
+            alignas (64) static constexpr auto signs = butterflySigns (Stride);
+            x = Register::mulAdd (x, Register::load (signs.data()), x.template swap<Stride>());
+            hadamardInRegister<Stride / 2> (x);
+        }
+    }
+
+    // +1 for the lanes that keep their sum, -1 for the ones that take the difference
+    static constexpr std::array<float, max_frame_lanes> butterflySigns (int stride)
+    {
+        std::array<float, max_frame_lanes> signs {};
+        for (int lane = 0; lane < max_frame_lanes; ++lane)
+            signs[(size_t) lane] = (lane & stride) == 0 ? 1.0f : -1.0f;
+
+        return signs;
+    }
+};
@@ -0,0 +1,298 @@
+/*
+  ==============================================================================
+
+    HalfBandFilter.h
+    Polyphase half-band decimation and interpolation for the reduced rate engine.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    A 39 tap Blackman windowed half-band lowpass, split into its two polyphase
+    branches. Every other tap of a half-band filter is zero except the centre
+    one, so one branch is a pure delay and the other a symmetric 20 tap FIR,
+    costing 10 multiplies per output sample at the lower rate.
+
+    Passband is flat to within 0.001 dB up to a sixth of the higher rate and
+    everything that would alias into it is at least 75 dB down, which covers
+    the audible band for 88.2 kHz and up.
+*/
+namespace half_band
+{
+    constexpr int half_taps = 10;
+    constexpr int branch_taps = 2 * half_taps;
+
+    // Delay of one filter, in samples at the higher of its two rates
+    constexpr int latency = branch_taps - 1;
+
+    // Taps of the filtering branch, oldest sample first (symmetric)
+    inline const std::array<float, branch_taps>& coefficients()
+    {
+        static const auto taps = []
+        {
+            constexpr int length = 2 * branch_taps - 1;
+            std::array<double, branch_taps> odd {};
+            double sum = 0.0;
+
+            for (int i = 0; i < branch_taps; ++i)
+            {
+                const int k = 2 * i;               // position in the full filter
+                const int n = k - (branch_taps - 1);   // odd offset from the centre
+                const double x = juce::MathConstants<double>::pi * n / 2.0;
+                const double phase = 2.0 * juce::MathConstants<double>::pi * k / (length - 1);
+                const double window = 0.42 - 0.5 * std::cos (phase) + 0.08 * std::cos (2.0 * phase);
+
+                odd[(size_t) i] = 0.5 * std::sin (x) / x * window;
+                sum += odd[(size_t) i];
+            }
+
+            // Unity gain at DC: the centre tap is 0.5 and the rest sum to 0.5
+            std::array<float, branch_taps> result {};
+            for (int i = 0; i < branch_taps; ++i)
+                result[(size_t) i] = (float) (odd[(size_t) i] * 0.5 / sum);
+
+            return result;
+        }();
+
+        return taps;
+    }
+}
+
+//==============================================================================
+/** Halves the rate of one channel. Each call takes 2 * n samples and returns n. */
+class HalfBandDecimator
+{
+public:
+    void prepare (int maxOutputSamples)
+    {
+        taps = half_band::coefficients();
+        even.allocate ((size_t) (even_history + maxOutputSamples), true);
+        odd.allocate ((size_t) (odd_history + maxOutputSamples), true);
+    }
+
+    void release()
+    {
+        even.free();
+        odd.free();
+    }
+
+    void reset()
+    {
+        if (even != nullptr)
+        {
+            juce::FloatVectorOperations::clear (even, even_history);
+            juce::FloatVectorOperations::clear (odd, odd_history);
+        }
+    }
+
+    void process (const float* input, float* output, int numOutputSamples)
+    {
+        for (int i = 0; i < numOutputSamples; ++i)
+        {
+            even[even_history + i] = input[2 * i];
+            odd[odd_history + i] = input[2 * i + 1];
+        }
+
+        // Centre tap on the odd branch, the symmetric FIR on the even one. One
+        // tap pair at a time over the whole block keeps the inner loop contiguous.
+        for (int m = 0; m < numOutputSamples; ++m)
+            output[m] = 0.5f * odd[m];
+
+        for (int i = 0; i < half_band::half_taps; ++i)
+        {
+            const float tap = taps[(size_t) i];
+            const float* newer = even + even_history - i;
+            const float* older = even + i;
+
+            for (int m = 0; m < numOutputSamples; ++m)
+                output[m] += tap * (newer[m] + older[m]);
+        }
+
+        std::copy (even + numOutputSamples, even + numOutputSamples + even_history, even.get());
+        std::copy (odd + numOutputSamples, odd + numOutputSamples + odd_history, odd.get());
+    }
+
+private:
+    static constexpr int even_history = half_band::branch_taps - 1;
+    static constexpr int odd_history = half_band::half_taps;
+
+    std::array<float, half_band::branch_taps> taps {};
+    juce::HeapBlock<float> even, odd;
+};
+
+//==============================================================================
+/** Doubles the rate of one channel. Each call takes n samples and returns 2 * n. */
+class HalfBandInterpolator
+{
+public:
+    void prepare (int maxInputSamples)
+    {
+        taps = half_band::coefficients();
+        samples.allocate ((size_t) (history + maxInputSamples), true);
+        filtered.allocate ((size_t) maxInputSamples, true);
+    }
+
+    void release()
+    {
+        samples.free();
+        filtered.free();
+    }
+
+    void reset()
+    {
+        if (samples != nullptr)
+            juce::FloatVectorOperations::clear (samples, history);
+    }
+
+    void process (const float* input, float* output, int numInputSamples)
+    {
+        std::copy (input, input + numInputSamples, samples + history);
+
+        // The zero stuffing halves the level, so both branches get a gain of two
+        juce::FloatVectorOperations::clear (filtered, numInputSamples);
+
+        for (int i = 0; i < half_band::half_taps; ++i)
+        {
+            const float tap = 2.0f * taps[(size_t) i];
+            const float* newer = samples + history - i;
+            const float* older = samples + i;
+
+            for (int m = 0; m < numInputSamples; ++m)
+                filtered[m] += tap * (newer[m] + older[m]);
+        }
+
+        for (int m = 0; m < numInputSamples; ++m)
+        {
+            output[2 * m] = filtered[m];
+            output[2 * m + 1] = samples[half_band::half_taps + m];
+        }
+
+        std::copy (samples + numInputSamples, samples + numInputSamples + history, samples.get());
+    }
+
+private:
+    static constexpr int history = half_band::branch_taps - 1;
+
+    std::array<float, half_band::branch_taps> taps {};
+    juce::HeapBlock<float> samples, filtered;
+};
+
+//==============================================================================
+/**
+    Cascade of up to max_stages factor-of-two stages for one channel, taking
+    it down to the network rate and back up again. With zero stages both
+    directions are a plain copy.
+*/
+class HalfBandCascade
+{
+public:
+    static constexpr int max_stages = 2;
+
+    void prepare (int numStages, int maxLowRateSamples)
+    {
+        jassert (numStages >= 0 && numStages <= max_stages);
+        num_stages = numStages;
+
+        for (int stage = 0; stage < num_stages; ++stage)
+        {
+            // Stage 0 runs between the host rate and half of it, and so on down
+            const int low_rate_samples = maxLowRateSamples << (num_stages - 1 - stage);
+            decimators[(size_t) stage].prepare (low_rate_samples);
+            interpolators[(size_t) stage].prepare (low_rate_samples);
+        }
+
+        for (int stage = num_stages; stage < max_stages; ++stage)
+        {
+            decimators[(size_t) stage].release();
+            interpolators[(size_t) stage].release();
+        }
+
+        if (num_stages > 1)
+        {
+            down_mid.allocate ((size_t) (2 * maxLowRateSamples), true);
+            up_mid.allocate ((size_t) (2 * maxLowRateSamples), true);
+        }
+        else
+        {
+            down_mid.free();
+            up_mid.free();
+        }
+    }
+
+    void release()
+    {
+        prepare (0, 0);
+    }
+
+    void reset()
+    {
+        for (int stage = 0; stage < num_stages; ++stage)
+        {
+            decimators[(size_t) stage].reset();
+            interpolators[(size_t) stage].reset();
+        }
+    }
+
+    int getFactor() const { return 1 << num_stages; }
+
+    // Delay of a trip down and back up, in samples at the high rate
+    int getLatency() const { return getLatency (num_stages); }
+
+    // The same for a cascade of numStages, before it is prepared
+    static int getLatency (int numStages)
+    {
+        int total = 0;
+        for (int stage = 0; stage < numStages; ++stage)
+            total += 2 * half_band::latency << stage;
+
+        return total;
+    }
+
+    // numLowRateSamples * getFactor() samples in, numLowRateSamples out
+    void downsample (const float* input, float* output, int numLowRateSamples)
+    {
+        switch (num_stages)
+        {
+            case 0:
+                juce::FloatVectorOperations::copy (output, input, numLowRateSamples);
+                break;
+            case 1:
+                decimators[0].process (input, output, numLowRateSamples);
+                break;
+            default:
+                decimators[0].process (input, down_mid, 2 * numLowRateSamples);
+                decimators[1].process (down_mid, output, numLowRateSamples);
+                break;
+        }
+    }
+
+    // numLowRateSamples in, numLowRateSamples * getFactor() samples out
+    void upsample (const float* input, float* output, int numLowRateSamples)
+    {
+        switch (num_stages)
+        {
+            case 0:
+                juce::FloatVectorOperations::copy (output, input, numLowRateSamples);
+                break;
+            case 1:
+                interpolators[0].process (input, output, numLowRateSamples);
+                break;
+            default:
+                interpolators[1].process (input, up_mid, numLowRateSamples);
+                interpolators[0].process (up_mid, output, 2 * numLowRateSamples);
+                break;
+        }
+    }
+
+private:
+    int num_stages = 0;
+
+    std::array<HalfBandDecimator, max_stages> decimators;
+    std::array<HalfBandInterpolator, max_stages> interpolators;
+    juce::HeapBlock<float> down_mid, up_mid;
+};
@@ -0,0 +1,158 @@
+/*
+  ==============================================================================
+
+    HalfFloat.h
+    IEEE 754 half precision samples, for compact delay line storage.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SimdLevel.h"
+
+#if defined (__F16C__)
+ #include <immintrin.h>
+#endif
+
+//==============================================================================
+/**
+    A sample stored in 16 bits: 1 sign, 5 exponent and 10 mantissa bits.
+
+    That is about 66 dB of signal to noise at any level, with subnormals
+    reaching down to -144 dBFS, which is enough to store audio. It is only a
+    storage format: convert to float to do arithmetic.
+
+    The conversions use the F16C instructions when the compiler targets
+    them, the AArch64 conversion instructions on ARM, and otherwise a few
+    integer operations. All of them round to nearest even and give the same
+    bits. None of them depend on the denormal flags, because the audio thread
+    runs with denormals flushed to zero and the half subnormals would be lost.
+*/
+struct HalfFloat
+{
+    juce::uint16 bits;
+
+    static HalfFloat fromFloat (float value) noexcept
+    {
+       #if defined (__F16C__)
+        return { (juce::uint16) _cvtss_sh (value, _MM_FROUND_TO_NEAREST_INT) };
+       #elif JUCE_ARM && defined (__aarch64__)
+        const __fp16 half = (__fp16) value;
+        juce::uint16 result;
+        std::memcpy (&result, &half, sizeof (result));
+        return { result };
+       #else
+        constexpr juce::uint32 infinity = 255u << 23;
+        constexpr juce::uint32 overflow = (127u + 16u) << 23;       // 2^16, just past the largest half
+        constexpr juce::uint32 smallest_normal = 113u << 23;        // 2^-14
+        constexpr juce::uint32 subnormal_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+        juce::uint32 x = toBits (value);
+        const juce::uint32 sign = x & 0x80000000u;
+        x ^= sign;
+
+        juce::uint16 result;
+        if (x >= overflow)
+        {
+            // Too large for a half, or already infinity or NaN
+            result = x > infinity ? 0x7e00 : 0x7c00;
+        }
+        else if (x < smallest_normal)
+        {
+            // Adding 0.5 lines the subnormal's bits up at the bottom of the
+            // mantissa, and the FPU does the rounding. Both operands and the
+            // sum are normal floats, so this is safe with denormals off.
+            result = (juce::uint16) (toBits (fromBits (x) + fromBits (subnormal_magic)) - subnormal_magic);
+        }
+        else
+        {
+            // Rebias the exponent and round the 13 dropped bits to nearest even
+            const juce::uint32 odd = (x >> 13) & 1u;
+            x += ((juce::uint32) (15 - 127) << 23) + 0xfffu + odd;
+            result = (juce::uint16) (x >> 13);
+        }
+
+        return { (juce::uint16) (result | (sign >> 16)) };
+       #endif
+    }
+
+    float toFloat() const noexcept
+    {
+       #if defined (__F16C__)
+        return _cvtsh_ss (bits);
+       #elif JUCE_ARM && defined (__aarch64__)
+        __fp16 half;
+        std::memcpy (&half, &bits, sizeof (half));
+        return (float) half;
+       #else
+        constexpr juce::uint32 shifted_exponent = 0x7c00u << 13;
+
+        juce::uint32 x = (juce::uint32) (bits & 0x7fff) << 13;
+        const juce::uint32 exponent = x & shifted_exponent;
+        x += (juce::uint32) (127 - 15) << 23;
+
+        if (exponent == shifted_exponent)
+        {
+            // Infinity or NaN
+            x += (juce::uint32) (128 - 16) << 23;
+        }
+        else if (exponent == 0)
+        {
+            // Zero or subnormal: build 1.m * 2^-14 and take the implicit 1
+            // back off, again with nothing but normal floats involved
+            x += 1u << 23;
+            x = toBits (fromBits (x) - fromBits (113u << 23));
+        }
+
+        return fromBits (x | (juce::uint32) (bits & 0x8000) << 16);
+       #endif
+    }
+
+private:
+    static juce::uint32 toBits (float value) noexcept
+    {
+        juce::uint32 result;
+        std::memcpy (&result, &value, sizeof (result));
+        return result;
+    }
+
+    static float fromBits (juce::uint32 value) noexcept
+    {
+        float result;
+        std::memcpy (&result, &value, sizeof (result));
+        return result;
+    }
+};
+
+#if JUCE_INTEL
+/**
+    The same samples, converted with the F16C instructions whatever the
+    compiler targets. Only use it in code compiled for SimdLevel::avx2 or
+    above, which every CPU with AVX2 runs.
+*/
+struct HalfFloatF16C
+{
+    juce::uint16 bits;
+
+    REVERB_AVX2_FUNCTION static HalfFloatF16C fromFloat (float value) noexcept
+    {
+        return { (juce::uint16) _cvtss_sh (value, _MM_FROUND_TO_NEAREST_INT) };
+    }
+
+    REVERB_AVX2_FUNCTION float toFloat() const noexcept { return _cvtsh_ss (bits); }
+};
+#endif
+
+// The half float type for code compiled for Level
+template <SimdLevel Level>
+struct HalfFloatFor
+{
+    using Type = HalfFloat;
+};
+
+#if JUCE_INTEL
+template <> struct HalfFloatFor<SimdLevel::avx2>   { using Type = HalfFloatF16C; };
+template <> struct HalfFloatFor<SimdLevel::avx512> { using Type = HalfFloatF16C; };
+#endif
@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    Lfo.h
+    Block rate sine oscillator for the delay modulation.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    A sine LFO that moves a whole block per step by rotating a (cos, sin)
+    pair, so a step is a few multiplies and no trig. The pair is pulled back
+    onto the unit circle on every step, which keeps the amplitude from
+    drifting however long it runs. The pair is double, so whether the
+    compiler fuses the multiplies, which differs between the network's
+    instruction sets, never builds up into a phase difference worth hearing.
+*/
+class QuadratureLfo
+{
+public:
+    // Each advance() moves samplesPerStep samples at sampleRate along a frequency Hz sine
+    void prepare (double frequency, double sampleRate, int samplesPerStep, double startPhase)
+    {
+        const double angle = juce::MathConstants<double>::twoPi * frequency * samplesPerStep / sampleRate;
+        step_cos = std::cos (angle);
+        step_sin = std::sin (angle);
+        start_phase = startPhase;
+        reset();
+    }
+
+    void reset()
+    {
+        cos_value = std::cos (start_phase);
+        sin_value = std::sin (start_phase);
+    }
+
+    // Steps once and returns the new value, from -1 to 1
+    float advance() noexcept
+    {
+        const double next_cos = cos_value * step_cos - sin_value * step_sin;
+        const double next_sin = sin_value * step_cos + cos_value * step_sin;
+
+        // First order correction towards unit length, plenty for a step this small
+        const double correction = 1.5 - 0.5 * (next_cos * next_cos + next_sin * next_sin);
+        cos_value = next_cos * correction;
+        sin_value = next_sin * correction;
+        return (float) sin_value;
+    }
+
+    float getValue() const noexcept { return (float) sin_value; }
+
+private:
+    double step_cos = 1.0, step_sin = 0.0;
+    double cos_value = 1.0, sin_value = 0.0;
+    double start_phase = 0.0;
+};
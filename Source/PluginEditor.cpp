@@ -11,11 +11,50 @@
 
 //==============================================================================
 LearningLiveProcessingAudioProcessorEditor::LearningLiveProcessingAudioProcessorEditor (LearningLiveProcessingAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p),
+      analyser_view (p.getAnalysisTap(), p), cpu_view (p.getProfiler())
 {
+    const std::pair<const char*, const char*> knob_parameters[] = {
+        { ParameterIds::size, "Size" },
+        { ParameterIds::predelay, "Pre-delay" },
+        { ParameterIds::decay, "Decay" },
+        { ParameterIds::diffusion, "Diffusion" },
+        { ParameterIds::modulation, "Modulation" },
+        { ParameterIds::damping, "Damping" },
+        { ParameterIds::early, "Early" }
+    };
+
+    for (size_t i = 0; i < knobs.size(); ++i)
+    {
+        auto& knob = knobs[i];
+
+        knob.slider.setSliderStyle (juce::Slider::RotaryHorizontalVerticalDrag);
+        knob.slider.setTextBoxStyle (juce::Slider::TextBoxBelow, false, 80, 20);
+        addAndMakeVisible (knob.slider);
+
+        knob.label.setText (knob_parameters[i].second, juce::dontSendNotification);
+        knob.label.setJustificationType (juce::Justification::centred);
+        knob.label.attachToComponent (&knob.slider, false);
+        addAndMakeVisible (knob.label);
+
+        knob.attachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment> (
+            audioProcessor.getParameters(), knob_parameters[i].first, knob.slider);
+    }
+
+    // The items come from the parameter, so the attachment's indices match its choices
+    if (auto* quality = dynamic_cast<juce::AudioParameterChoice*> (audioProcessor.getParameters().getParameter (ParameterIds::quality)))
+        quality_box.addItemList (quality->choices, 1);
+
+    addAndMakeVisible (quality_box);
+    quality_attachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment> (
+        audioProcessor.getParameters(), ParameterIds::quality, quality_box);
+
+    addAndMakeVisible (analyser_view);
+    addAndMakeVisible (cpu_view);
+
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (400, 300);
+    setSize (560, 640);
 }
 
 LearningLiveProcessingAudioProcessorEditor::~LearningLiveProcessingAudioProcessorEditor()
@@ -30,11 +69,26 @@ void LearningLiveProcessingAudioProcessorEditor::paint (juce::Graphics& g)
 
     g.setColour (juce::Colours::white);
     g.setFont (juce::FontOptions (15.0f));
-    g.drawFittedText ("Delay", getLocalBounds(), juce::Justification::centred, 1);
+    g.drawFittedText ("Delay", getLocalBounds().removeFromTop (40), juce::Justification::centred, 1);
 }
 
 void LearningLiveProcessingAudioProcessorEditor::resized()
 {
     // This is generally where you'll want to lay out the positions of any
     // subcomponents in your editor..
+    auto area = getLocalBounds().reduced (10);
+
+    // Quality sits at the right of the title strip
+    quality_box.setBounds (area.removeFromTop (40).removeFromRight (120).withSizeKeepingCentre (120, 24));
+
+    // CPU breakdown along the bottom, the analysers above it, and the knobs keep their original height
+    cpu_view.setBounds (area.removeFromBottom (180));
+    area.removeFromBottom (10);
+    analyser_view.setBounds (area.removeFromBottom (150));
+    area.removeFromBottom (10);
+
+    // Leave room above each knob for its attached label
+    const int knob_width = area.getWidth() / (int) knobs.size();
+    for (auto& knob : knobs)
+        knob.slider.setBounds (area.removeFromLeft (knob_width).reduced (5).withTrimmedTop (20));
 }
@@ -10,6 +10,8 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "CpuBreakdownView.h"
+#include "AnalyserView.h"
 
 //==============================================================================
 /**
@@ -29,5 +31,22 @@ private:
     // access the processor object that created it.
     LearningLiveProcessingAudioProcessor& audioProcessor;
 
+    // One rotary control per reverb parameter
+    struct ParameterKnob
+    {
+        juce::Slider slider;
+        juce::Label label;
+        std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> attachment;
+    };
+
+    std::array<ParameterKnob, 7> knobs;
+
+    // The network tier, switched while playing with a short crossfade
+    juce::ComboBox quality_box;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> quality_attachment;
+
+    AnalyserView analyser_view;
+    CpuBreakdownView cpu_view;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LearningLiveProcessingAudioProcessorEditor)
 };
@@ -8,10 +8,9 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
-#include <random>
 
 //==============================================================================
-LearningLiveProcessingAudioProcessor::LearningLiveProcessingAudioProcessor()
+LearningLiveProcessingAudioProcessor::LearningLiveProcessingAudioProcessor(ReverbTier tier)
 #ifndef JucePlugin_PreferredChannelConfigurations
      : AudioProcessor (BusesProperties()
                      #if ! JucePlugin_IsMidiEffect
@@ -22,11 +21,79 @@ LearningLiveProcessingAudioProcessor::LearningLiveProcessingAudioProcessor()
                      #endif
                        )
 #endif
+    , network_tier (tier)
+    , topology_seed (static_cast<juce::uint32>(juce::Random::getSystemRandom().nextInt()))
+    , parameters (*this, nullptr, "PARAMETERS", createParameterLayout())
+    , profiler ({ "Input", "Diffusion 1", "Diffusion 2", "Diffusion 3", "Diffusion 4", "Final delay", "Output mix", "Block" })
 {
+    static_assert(profile_final_delay == profile_diffusion + max_diffusion_stages, "one profile stage per diffusion");
+
+    size_parameter = parameters.getRawParameterValue(ParameterIds::size);
+    predelay_parameter = parameters.getRawParameterValue(ParameterIds::predelay);
+    decay_parameter = parameters.getRawParameterValue(ParameterIds::decay);
+    diffusion_parameter = parameters.getRawParameterValue(ParameterIds::diffusion);
+    modulation_parameter = parameters.getRawParameterValue(ParameterIds::modulation);
+    damping_parameter = parameters.getRawParameterValue(ParameterIds::damping);
+    early_parameter = parameters.getRawParameterValue(ParameterIds::early);
+    quality_parameter = parameters.getRawParameterValue(ParameterIds::quality);
+
+    // The Quality parameter starts on the tier the instance was made with
+    setNetworkTier(network_tier.load());
+
+    // Polarities and channel swaps don't depend on the sample rate or block
+    // size, so the networks are made once here and kept across re-prepares
+    create_engines();
+
+    startTimerHz(quality_timer_hz);
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout LearningLiveProcessingAudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+
+    // Scales every delay in the network, diffusion and feedback alike. The
+    // delays glide to a new size, so automating it bends the pitch rather than clicking.
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { ParameterIds::size, 1 }, "Size",
+        juce::NormalisableRange<float>(min_size, max_size, 0.01f), 1.0f));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { ParameterIds::predelay, 1 }, "Pre-delay",
+        juce::NormalisableRange<float>(0.0f, max_predelay_ms, 0.1f), 0.0f,
+        juce::AudioParameterFloatAttributes().withLabel("ms")));
+
+    // RT60 of the feedback loop. The default gives the original -1.8 dB per 0.2 s pass.
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { ParameterIds::decay, 1 }, "Decay",
+        juce::NormalisableRange<float>(0.2f, 20.0f, 0.01f, 0.4f), 0.2f * 60.0f / 1.8f,
+        juce::AudioParameterFloatAttributes().withLabel("s")));
+
+    // How much each diffusion stage mixes its lanes, from discrete echoes (0) to a full Hadamard mix (1)
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { ParameterIds::diffusion, 1 }, "Diffusion",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 1.0f));
+
+    // Depth of the LFOs on the delay lengths, which breaks up the metallic ringing of fixed delays
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { ParameterIds::modulation, 1 }, "Modulation",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.0f));
+
+    // How much faster the highs die away than the lows. At 1 the treble decay
+    // time is a tenth of Decay; at 0 the loop is a broadband gain as before.
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { ParameterIds::damping, 1 }, "Damping",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.0f));
+
+    // Level of the early reflections, into the output and into the diffusers alike. At 0 the stage is skipped.
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { ParameterIds::early, 1 }, "Early reflections",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.0f));
+
+    // Density of the network against its CPU cost: 4, 8 or 16 channels with 2, 3 or 4 diffusion stages
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { ParameterIds::quality, 1 }, "Quality",
+        juce::StringArray { "Eco", "Standard", "High" }, static_cast<int>(ReverbTier::standard)));
+
+    return layout;
 }
 
 LearningLiveProcessingAudioProcessor::~LearningLiveProcessingAudioProcessor()
 {
+    // The workers call back into this object, so they must be gone before any member is
+    pipeline.stop();
+    stopTimer();
 }
 
 //==============================================================================
@@ -64,7 +131,20 @@ bool LearningLiveProcessingAudioProcessor::isMidiEffect() const
 
 double LearningLiveProcessingAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // Time for an impulse to get through the pre-delay, the latest early
+    // reflection and the diffusion, then for the feedback network to bring
+    // it down to the silence threshold. The audio thread can switch network
+    // at any time, so the tier is read once and its engine looked up.
+    const float size = size_parameter->load();
+    const auto& engine = *engines[static_cast<size_t>(network_tier.load())];
+    const double network_time = predelay_parameter->load() * 0.001 + EarlyReflections::longest_seconds * size
+                                + engine.getPathSeconds(size);
+
+    // The Householder matrix is lossless, so the network decays at exactly the
+    // Decay RT60, plus one pass of the longest loop before anything comes back
+    const double decay_time = decay_parameter->load() * juce::Decibels::gainToDecibels((double) silence_threshold) / -60.0;
+
+    return network_time + decay_time + (double) getLatencySamples() / juce::jmax(sample_rate, 1.0);
 }
 
 int LearningLiveProcessingAudioProcessor::getNumPrograms()
@@ -91,94 +171,344 @@ void LearningLiveProcessingAudioProcessor::changeProgramName (int index, const j
 {
 }
 
-// Helper for random polarities
-std::vector<int> gen_polarity_values(int channel_count) {
-    std::vector<int> result;
-    result.reserve(channel_count); // Reserve space for n entries
-
-    // Seed the random number generator
-    std::srand(static_cast<unsigned int>(std::time(0)));
+//==============================================================================
+void LearningLiveProcessingAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
+{
+    // Use this method as the place to do any pre-playback
+    // initialisation that you need..
 
-    // Fill the vector with random 1 or -1
-    for (int i = 0; i < channel_count; ++i) {
-        int randomValue = (std::rand() % 2 == 0) ? 1 : -1;
-        result.push_back(randomValue);
+    // The workers own the delay lines while they run, so stop them before touching anything
+    pipeline.stop();
+
+    // The timer prepares tiers too, so it waits until this is done
+    const juce::ScopedLock tier_scope(tier_lock);
+
+    // Many hosts prepare again on every transport start with nothing changed.
+    // Then every allocation is kept and only the reverb state is cleared.
+    // A Quality change made while stopped just prepares the new tier, except
+    // in pipelined mode where the tier sets the pipeline's length and with
+    // it the dry delay.
+    network_tier = requested_tier();
+    const bool storage_is_current = storage_prepared && sampleRate == sample_rate
+                                    && samplesPerBlock == samples_per_block
+                                    && pipelined_diffusion == storage_pipelined
+                                    && reduced_rate_engine == storage_reduced_rate
+                                    && half_precision_delays == storage_half_precision
+                                    && simd_level == storage_simd_level
+                                    && (!pipelined_diffusion || network_tier == storage_tier);
+
+    // A new sample type or instruction set is a whole new set of networks, made here rather than on the audio thread
+    if (half_precision_delays != storage_half_precision || simd_level != storage_simd_level) {
+        create_engines();
     }
 
-    return result;
-}
+    network = engines[static_cast<size_t>(network_tier.load())].get();
+    outgoing_network = nullptr;
+
+    // Save sample rate
+    sample_rate = sampleRate;
+    samples_per_block = samplesPerBlock;
 
-// Generate indicies to swap channels
-std::vector<int> gen_swap_values(int channel_count) {
-    std::vector<int> result(channel_count);
-    for (int i = 0; i < channel_count; ++i) {
-        result[i] = i;
+    // Halve the network rate for as long as it stays at or above min_network_rate
+    int rate_stages = 0;
+    if (reduced_rate_engine) {
+        while (rate_stages < HalfBandCascade::max_stages && sample_rate / (2 << rate_stages) >= min_network_rate) {
+            rate_stages++;
+        }
     }
+    rate_factor = 1 << rate_stages;
+    network_rate = sample_rate / rate_factor;
+
+    // One pipeline tick per host block, in whole quanta. Otherwise the FIFOs hold one quantum.
+    const int network_block = (samples_per_block + rate_factor - 1) / rate_factor;
+    pipeline_hop = (network_block + internal_quantum - 1) / internal_quantum * internal_quantum;
+    fifo_size = (pipelined_diffusion ? pipeline_hop : internal_quantum) * rate_factor;
+
+    // One pipeline stage per diffusion plus one for the final delay
+    pipeline_stages = network->getNumStages() + 1;
+
+    // A hop leaves the last stage pipeline_stages ticks after it went in, and
+    // the resampling filters add their own delay on top
+    dry_delay_samples = HalfBandCascade::getLatency(rate_stages);
+    if (pipelined_diffusion) {
+        dry_delay_samples += pipeline_stages * pipeline_hop * rate_factor;
+    }
+
+    // The early reflections skip the pipeline, so they wait out its latency instead
+    early_output_delay = pipelined_diffusion ? pipeline_stages * pipeline_hop : 0;
 
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(result.begin(), result.end(), g);
+    if (!storage_is_current)
+        prepare_storage(rate_stages);
+
+    // Only the current tier holds delay memory. Preparing it again at the
+    // same rate keeps its allocation, and a Quality switch has the timer
+    // prepare the next one.
+    for (auto& engine : engines) {
+        if (engine.get() == network)
+            engine->prepare(network_rate);
+        else
+            engine->release();
+    }
+    offered_tier = -1;
+    retired_tier = -1;
+    pending_tier = -1;
+    audio_tiers = 1 << static_cast<int>(network_tier.load());
+
+    asleep = false;
+    falling_asleep = false;
+    silent_input_samples = 0;
+    quiet_output_samples = 0;
+
+    // PARAMETER INITIALIZATION
+
+    // Start from the current values rather than ramping up from wherever the last session left off
+    size_smoothed.reset(network_rate, parameter_ramp_seconds);
+    predelay_smoothed.reset(network_rate, parameter_ramp_seconds);
+    decay_smoothed.reset(network_rate, parameter_ramp_seconds);
+    diffusion_smoothed.reset(network_rate, parameter_ramp_seconds);
+    modulation_smoothed.reset(network_rate, parameter_ramp_seconds);
+    damping_smoothed.reset(network_rate, parameter_ramp_seconds);
+    early_smoothed.reset(network_rate, parameter_ramp_seconds);
+    quality_fade.reset(network_rate, quality_crossfade_seconds);
+    size_smoothed.setCurrentAndTargetValue(size_parameter->load());
+    predelay_smoothed.setCurrentAndTargetValue(predelay_parameter->load());
+    decay_smoothed.setCurrentAndTargetValue(decay_parameter->load());
+    diffusion_smoothed.setCurrentAndTargetValue(diffusion_parameter->load());
+    modulation_smoothed.setCurrentAndTargetValue(modulation_parameter->load());
+    damping_smoothed.setCurrentAndTargetValue(damping_parameter->load());
+    early_smoothed.setCurrentAndTargetValue(early_parameter->load());
+    quality_fade.setCurrentAndTargetValue(1.0f);
+    apply_network_settings();
+
+    // Starts every line and LFO from the settings just applied
+    clear_state();
+
+    // The dry signal is held back to stay in line with the wet one
+    setLatencySamples(fifo_size + dry_delay_samples);
+
+    if (pipelined_diffusion) {
+        pipeline.start(*this, pipeline_stages, 1000.0 * pipeline_hop / network_rate);
+    }
 
-    return result;
 }
 
-//==============================================================================
-void LearningLiveProcessingAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
+// Sizes every delay line and buffer for the current sample rate, block size
+// and mode. Lines whose capacity is unchanged keep their allocation.
+void LearningLiveProcessingAudioProcessor::prepare_storage(int rate_stages)
 {
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
+    // WORKING STORAGE INITIALIZATION
 
-    // Save sample rate
-    sample_rate = sampleRate;
-    samples_per_block = samplesPerBlock;
+    // Everything processBlock needs is carved out of this once, here.
+    // Each slot holds one quantum of interleaved frames of the widest tier,
+    // so neither the host block size nor the tier changes how much is needed.
+    scratch.prepare(num_scratch_slots, max_network_channels * internal_quantum);
+    outgoing_output.setSize(2, internal_quantum, false, true, true);
+    incoming_output.setSize(2, internal_quantum, false, true, true);
 
-    // DIFFUSE DELAY INITIALIZATION
+    // PIPELINE INITIALIZATION
 
-    // For each diffusion setup delay variables
-    for (int diff = 0; diff < diffusion_count; diff++) {
-        // Generate delay times for this diffusion
-        std::vector<float> cur_delay_times;
-        for (int channel = 0; channel < numChannels; channel++) {
-            cur_delay_times.push_back((channel + 1) * delay_steps[diff]);
-        }
-        delay_times.push_back(cur_delay_times);
+    if (pipelined_diffusion) {
+        pipeline_scratch.prepare(num_pipeline_slots, max_network_channels * pipeline_hop);
+    }
+    else {
+        pipeline_scratch.release();
+    }
 
-        // Initiate to 0 as reference point
-        max_delays_in_samples.push_back(0);
+    for (auto& line : dry_delay_lines) {
+        if (dry_delay_samples > 0)
+            line.prepare(dry_delay_samples, fifo_size);
+        else
+            line.release();
+    }
 
-        // Create the randomized polarities and swaps for each diffusion
-        polarities.push_back(gen_polarity_values(numChannels));
-        swaps.push_back(gen_swap_values(numChannels));
+    // REDUCED RATE INITIALIZATION
 
-        // Make sure vectors are created and properly sized
-        channel_samples_delayed.push_back({});
-        channel_samples_delayed[diff].resize(numChannels);
-        delay_buf_sizes.push_back({});
-        delay_buf_sizes[diff].resize(numChannels);
+    const int network_block = fifo_size / rate_factor;
+    for (auto& resampler : resamplers) {
+        resampler.prepare(rate_stages, network_block);
+    }
 
-        for (int channel = 0; channel < numChannels; channel++) {
-            int delay_in_samples = static_cast<int>(std::round(delay_times[diff][channel] * sample_rate));
-            if (delay_in_samples > max_delays_in_samples[diff]) max_delays_in_samples[diff] = delay_in_samples;
-            channel_samples_delayed[diff][channel] = delay_in_samples;
-        }
+    if (rate_factor > 1) {
+        network_input.setSize(2, network_block, false, true, true);
+        network_output.setSize(2, network_block, false, true, true);
+        upsampled_output.setSize(2, fifo_size, false, true, true);
+    }
+    else {
+        network_input.setSize(0, 0);
+        network_output.setSize(0, 0);
+        upsampled_output.setSize(0, 0);
+    }
 
-        // Create the audio buffer to store delays in and clear it
-        delay_buffers.push_back(juce::AudioBuffer<float>(numChannels, max_delays_in_samples[diff] + samples_per_block));
-        delay_buffers[diff].clear();
+    fifo_input.setSize(2, fifo_size, false, true, true);
+    fifo_output.setSize(2, fifo_size, false, true, true);
+    fifo_input.clear();
+    fifo_output.clear();
+    fifo_fill = 0;
+
+    const int max_predelay_samples = static_cast<int>(std::round(max_predelay_ms * 0.001 * network_rate));
+    for (auto& line : predelay_lines) {
+        line.prepare(max_predelay_samples, network_block);
     }
+    predelayed_input.setSize(2, network_block, false, true, true);
+
+    early_reflections.prepare(network_rate, max_size, early_output_delay, network_block);
+    early_output.setSize(2, network_block, false, true, true);
+
+    storage_prepared = true;
+    storage_pipelined = pipelined_diffusion;
+    storage_tier = network_tier;
+    storage_reduced_rate = reduced_rate_engine;
+}
 
-    // FINAL DELAY INITIALIZATION
+// Silences the reverb without touching any allocation
+void LearningLiveProcessingAudioProcessor::clear_state()
+{
+    network->clear();
+
+    clear_wet_lines();
 
-    f_samples_delayed = static_cast<int>(std::round(f_delay_time * sample_rate));
-    f_delay_buffer = juce::AudioBuffer<float>(1, f_samples_delayed + samples_per_block);
-    f_delay_buffer.clear();
+    for (auto& line : dry_delay_lines) {
+        line.clear();
+    }
 
+    fifo_input.clear();
+    fifo_output.clear();
+    fifo_fill = 0;
+}
+
+// The short lines around the network on the wet path, a few hundred
+// kilobytes at most, so they are cleared in one go even on the audio thread
+void LearningLiveProcessingAudioProcessor::clear_wet_lines()
+{
+    for (int channel = 0; channel < 2; ++channel) {
+        predelay_lines[channel].clear();
+        resamplers[channel].reset();
+    }
+    predelay_position = static_cast<float>(predelay_samples);
+
+    early_reflections.clear();
+
+    // The pipeline reads its first hops before anything has been written to them
+    pipeline_scratch.clear();
 }
 
 void LearningLiveProcessingAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    pipeline.stop();
+
+    const juce::ScopedLock tier_scope(tier_lock);
+
+    // A deactivated instance keeps only its topologies, a few kilobytes
+    for (auto& engine : engines) {
+        engine->release();
+    }
+    outgoing_network = nullptr;
+    offered_tier = -1;
+    retired_tier = -1;
+    pending_tier = -1;
+    audio_tiers = 0;
+
+    for (int channel = 0; channel < 2; ++channel) {
+        predelay_lines[channel].release();
+        dry_delay_lines[channel].release();
+        resamplers[channel].release();
+    }
+
+    early_reflections.release();
+
+    scratch.release();
+    pipeline_scratch.release();
+
+    fifo_input.setSize(0, 0);
+    fifo_output.setSize(0, 0);
+    predelayed_input.setSize(0, 0);
+    early_output.setSize(0, 0);
+    outgoing_output.setSize(0, 0);
+    incoming_output.setSize(0, 0);
+    network_input.setSize(0, 0);
+    network_output.setSize(0, 0);
+    upsampled_output.setSize(0, 0);
+
+    storage_prepared = false;
+}
+
+void LearningLiveProcessingAudioProcessor::setPipelinedDiffusion(bool should_pipeline)
+{
+    pipelined_diffusion = should_pipeline;
+}
+
+void LearningLiveProcessingAudioProcessor::setReducedRateEngine(bool should_reduce)
+{
+    reduced_rate_engine = should_reduce;
+}
+
+void LearningLiveProcessingAudioProcessor::setNetworkTier(ReverbTier tier)
+{
+    auto* quality = parameters.getParameter(ParameterIds::quality);
+    quality->setValueNotifyingHost(quality->convertTo0to1(static_cast<float>(tier)));
+}
+
+void LearningLiveProcessingAudioProcessor::setHalfPrecisionDelays(bool should_use_half)
+{
+    half_precision_delays = should_use_half;
+}
+
+void LearningLiveProcessingAudioProcessor::setSimdLevel(SimdLevel level)
+{
+    simd_level = juce::jmin(level, getSupportedSimdLevel());
+}
+
+size_t LearningLiveProcessingAudioProcessor::getNetworkDelayBytes() const
+{
+    const juce::ScopedLock tier_scope(tier_lock);
+
+    size_t bytes = 0;
+    for (auto& engine : engines) {
+        bytes += engine->getDelayBytes();
+    }
+    return bytes;
+}
+
+// One network per tier, sharing the topology seed
+void LearningLiveProcessingAudioProcessor::create_engines()
+{
+    for (int tier = 0; tier < num_reverb_tiers; ++tier) {
+        engines[static_cast<size_t>(tier)]
+            = createReverbEngine<internal_quantum>(static_cast<ReverbTier>(tier), topology_seed, half_precision_delays, simd_level);
+    }
+
+    network = engines[static_cast<size_t>(network_tier.load())].get();
+    outgoing_network = nullptr;
+    storage_half_precision = half_precision_delays;
+    storage_simd_level = simd_level;
+}
+
+void LearningLiveProcessingAudioProcessor::setTopologySeed(juce::uint32 seed)
+{
+    topology_seed = seed;
+
+    // Building the tables allocates, so it happens before the lock is taken
+    std::array<std::shared_ptr<const void>, num_reverb_tiers> tables;
+    for (size_t tier = 0; tier < engines.size(); ++tier) {
+        tables[tier] = engines[tier]->findTopology(seed);
+    }
+
+    // The wrappers hold the callback lock around processBlock, and the
+    // pipeline workers only start a tick from there, so once they are idle
+    // nothing reads the tables. Only pointers change hands under the lock;
+    // the old tables are freed, if nothing else holds them, once it is released.
+    {
+        const juce::ScopedLock lock(getCallbackLock());
+        if (pipeline.isRunning()) {
+            pipeline.waitForStages();
+        }
+
+        for (size_t tier = 0; tier < engines.size(); ++tier) {
+            tables[tier] = engines[tier]->setTopology(std::move(tables[tier]));
+        }
+    }
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -207,385 +537,607 @@ bool LearningLiveProcessingAudioProcessor::isBusesLayoutSupported (const BusesLa
 }
 #endif
 
-juce::AudioBuffer<float> LearningLiveProcessingAudioProcessor::split_input(juce::AudioBuffer<float>& buffer, int input_channel) {
-    juce::dsp::AudioBlock<float> block{ buffer };
+// Planar -> interleaved through the input matrix: both input channels go into the one network
+void LearningLiveProcessingAudioProcessor::split_input(const juce::AudioBuffer<float>& buffer, int start_sample, float* output) {
+    network->split(buffer.getReadPointer(0, start_sample), buffer.getReadPointer(1, start_sample), output);
+}
+
+// Interleaved -> planar through the output matrix: adds the stereo wet signal
+// from both paths and the early reflections to the output, or to
+// network_output when that is resampled
+void LearningLiveProcessingAudioProcessor::decode_output(const float* diffused, const float* final_delayed, int num_samples) {
+    if (rate_factor > 1) {
+        network_output.clear(0, num_samples);
+    }
 
-    auto* channelData = block.getChannelPointer(input_channel);
+    auto& target = rate_factor > 1 ? network_output : fifo_output;
 
-    juce::AudioBuffer<float> split_data = juce::AudioBuffer<float>(numChannels, block.getNumSamples());
-    split_data.clear();
+    // Mid Quality switch the two tiers are crossfaded, so the new one is decoded on its own first
+    if (outgoing_network != nullptr) {
+        incoming_output.clear(0, num_samples);
+        network->decode(diffused, final_delayed, incoming_output.getWritePointer(0), incoming_output.getWritePointer(1), num_samples);
 
-    for (int channel = 0; channel < numChannels; channel++) {
-        split_data.copyFrom(channel, 0, buffer, input_channel, 0, block.getNumSamples());
+        for (int channel = 0; channel < 2; ++channel) {
+            target.addFromWithRamp(channel, 0, incoming_output.getReadPointer(channel), num_samples,
+                                   crossfade_gain(fade_start), crossfade_gain(fade_end));
+            target.addFromWithRamp(channel, 0, outgoing_output.getReadPointer(channel), num_samples,
+                                   crossfade_gain(1.0f - fade_start), crossfade_gain(1.0f - fade_end));
+        }
+    }
+    else {
+        network->decode(diffused, final_delayed, target.getWritePointer(0), target.getWritePointer(1), num_samples);
     }
 
-    return split_data;
+    if (early_level > 0.0f) {
+        for (int channel = 0; channel < 2; ++channel) {
+            target.addFrom(channel, 0, early_output, channel, 0, num_samples);
+        }
+    }
+}
+
+// Runs in place on frames, using scratch as the other half of a ping-pong pair
+void LearningLiveProcessingAudioProcessor::diffuse(float* frames, float* scratch_frames) {
+    const int diff_count = network->getNumStages();
+
+    for (int diff = 0; diff < diff_count; diff++) {
+        StageProfiler::ScopedProbe probe(profiler, profile_diffusion + diff, internal_quantum);
+        network->diffuse(diff, frames, scratch_frames);
+        std::swap(frames, scratch_frames);
+    }
+
+    // An odd number of stages leaves the result in the scratch half
+    if (diff_count % 2 != 0) {
+        juce::FloatVectorOperations::copy(scratch_frames, frames, internal_quantum * network->getNumChannels());
+    }
 }
 
-void householderMix4Channels(juce::AudioBuffer<float>& buffer)
+void LearningLiveProcessingAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    // Ensure we have exactly 4 channels
-    jassert(buffer.getNumChannels() == 4);
+    juce::ScopedNoDenormals noDenormals;
+    StageProfiler::ScopedProbe block_probe(profiler, profile_block, buffer.getNumSamples());
+   #if REVERB_PROFILING
+    const auto block_start = juce::Time::getHighResolutionTicks();
+   #endif
+
+    auto totalNumInputChannels  = getTotalNumInputChannels();
+    auto totalNumOutputChannels = getTotalNumOutputChannels();
+
+    // In case we have more outputs than inputs, this code clears any output
+    // channels that didn't contain input data, (because these aren't
+    // guaranteed to be empty - they may contain garbage).
+    // This is here to avoid people getting screaming feedback
+    // when they first compile a plugin, but obviously you don't need to keep
+    // this code if your algorithm always overwrites all the output channels.
+    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+        buffer.clear (i, 0, buffer.getNumSamples());
 
-    const int numSamples = buffer.getNumSamples();
+    // This is the place where you'd normally do the guts of your plugin's
+    // audio processing...
+    // Make sure to reset the state if your inner loop is processing
+    // the samples and the outer loop is handling the channels.
+    // Alternatively, you can process the samples with the channels
+    // interleaved by keeping the same state.
 
-    // Get write pointers for all channels
-    float* ch0 = buffer.getWritePointer(0);
-    float* ch1 = buffer.getWritePointer(1);
-    float* ch2 = buffer.getWritePointer(2);
-    float* ch3 = buffer.getWritePointer(3);
+    // Hosts may send any number of samples per call, including more than they
+    // announced in prepareToPlay. Input is queued until a whole quantum is
+    // ready and output is handed back one quantum later, so the network only
+    // ever sees internal_quantum samples.
+    const int num_samples = buffer.getNumSamples();
+    const int num_io_channels = juce::jmin(buffer.getNumChannels(), fifo_input.getNumChannels());
 
-    // Householder mixing matrix coefficients
-    const float scale = 0.25f; // 1/sqrt(4) for energy preservation
-    const float diag = scale;    // Diagonal elements
-    const float offDiag = -scale; // Off-diagonal elements
+    for (int pos = 0; pos < num_samples;) {
+        const int chunk = juce::jmin(num_samples - pos, fifo_size - fifo_fill);
 
-    for (int i = 0; i < numSamples; ++i)
-    {
-        // Read original samples
-        const float in0 = ch0[i];
-        const float in1 = ch1[i];
-        const float in2 = ch2[i];
-        const float in3 = ch3[i];
+        for (int channel = 0; channel < num_io_channels; ++channel) {
+            fifo_input.copyFrom(channel, fifo_fill, buffer, channel, pos, chunk);
+            buffer.copyFrom(channel, pos, fifo_output, channel, fifo_fill, chunk);
+        }
 
-        // Apply Householder matrix mixing
-        // Matrix structure:
-        // [ diag  offDiag offDiag offDiag ]
-        // [ offDiag diag  offDiag offDiag ]
-        // [ offDiag offDiag diag  offDiag ]
-        // [ offDiag offDiag offDiag diag  ]
-        ch0[i] = diag * in0 + offDiag * in1 + offDiag * in2 + offDiag * in3;
-        ch1[i] = offDiag * in0 + diag * in1 + offDiag * in2 + offDiag * in3;
-        ch2[i] = offDiag * in0 + offDiag * in1 + diag * in2 + offDiag * in3;
-        ch3[i] = offDiag * in0 + offDiag * in1 + offDiag * in2 + diag * in3;
+        // A mono bus feeds both sides of the input matrix
+        if (num_io_channels == 1) {
+            fifo_input.copyFrom(1, fifo_fill, buffer, 0, pos, chunk);
+        }
+
+        fifo_fill += chunk;
+        pos += chunk;
+
+        if (fifo_fill == fifo_size) {
+            if (input_is_silent() && (asleep || falling_asleep))
+                pass_dry_through();
+            else if (pipeline.isRunning())
+                process_pipeline_hop();
+            else
+                process_quantum();
+
+            update_sleep_state();
+            fifo_fill = 0;
+        }
+    }
+
+    if (num_io_channels > 0) {
+        analysis_tap.push(buffer.getReadPointer(0), buffer.getReadPointer(num_io_channels - 1), num_samples);
+    }
+
+   #if REVERB_PROFILING
+    // A block that took longer than it lasts is a dropout, whatever the
+    // average. A block before the first prepareToPlay has no period to miss.
+    if (sample_rate > 0.0) {
+        const auto period = static_cast<juce::int64>(num_samples / sample_rate * juce::Time::getHighResolutionTicksPerSecond());
+        profiler.recordDeadline(juce::Time::getHighResolutionTicks() - block_start, period);
     }
+   #endif
 }
 
-void householderMix8Channels(juce::AudioBuffer<float>& buffer)
+void LearningLiveProcessingAudioProcessor::process_quantum()
 {
-    // Ensure we have exactly 8 channels
-    jassert(buffer.getNumChannels() == 8);
+    // Interleaved frames from the preallocated arena, nothing below touches the heap
+    constexpr int num_samples = internal_quantum;
+    jassert(num_samples * network->getNumChannels() <= scratch.getSlotSize());
 
-    const int numSamples = buffer.getNumSamples();
-    const float scale = 1.0f / 10.0f; // 1/n for energy preservation
+    float* multichannel_data = scratch.get(split_slot);
+    float* diffuse_scratch = scratch.get(diffuse_scratch_slot);
+    float* final_delayed = scratch.get(final_output_slot);
 
-    // Get write pointers for all channels
-    float* channels[8];
-    for (int c = 0; c < 8; ++c)
-        channels[c] = buffer.getWritePointer(c);
+    advance_parameters(num_samples);
 
-    for (int i = 0; i < numSamples; ++i)
+    // One pass of the network carries both input channels
     {
-        // Read and sum all inputs
-        float sum = 0.0f;
-        float inputs[8];
+        StageProfiler::ScopedProbe probe(profiler, profile_input, num_samples);
+        apply_predelay(network_rate_input(num_samples), num_samples);
+        apply_early_reflections(num_samples);
+        split_input(predelayed_input, 0, multichannel_data);
+    }
 
-        for (int c = 0; c < 8; ++c) {
-            inputs[c] = channels[c][i];
-            sum += inputs[c];
-        }
+    diffuse(multichannel_data, diffuse_scratch);
 
-        // Householder formula: output = input - 2*(sum/8)
-        const float householderTerm = 2.0f * sum * scale;
+    {
+        StageProfiler::ScopedProbe probe(profiler, profile_final_delay, num_samples);
+        network->feedback(multichannel_data, final_delayed, diffuse_scratch);
+    }
 
-        for (int c = 0; c < 8; ++c)
-            channels[c][i] = inputs[c] - householderTerm;
+    if (outgoing_network != nullptr) {
+        run_outgoing_network(num_samples);
     }
+
+    const float* diffused_signal = multichannel_data;
+
+    // Dry signal, with the stereo wet signal on top
+    StageProfiler::ScopedProbe probe(profiler, profile_output, num_samples);
+    write_dry();
+    decode_output(diffused_signal, final_delayed, num_samples);
+    add_upsampled_output(num_samples);
 }
 
-juce::AudioBuffer<float> LearningLiveProcessingAudioProcessor::final_delay(juce::AudioBuffer<float>& buffer) {
+// Moves the smoothers on by one quantum (or pipeline hop) and refreshes the
+// network settings if anything changed. The settings are constant within a quantum.
+void LearningLiveProcessingAudioProcessor::advance_parameters(int num_samples)
+{
+    size_smoothed.setTargetValue(size_parameter->load());
+    predelay_smoothed.setTargetValue(predelay_parameter->load());
+    decay_smoothed.setTargetValue(decay_parameter->load());
+    diffusion_smoothed.setTargetValue(diffusion_parameter->load());
+    modulation_smoothed.setTargetValue(modulation_parameter->load());
+    damping_smoothed.setTargetValue(damping_parameter->load());
+    early_smoothed.setTargetValue(early_parameter->load());
+
+    const float size = size_smoothed.getCurrentValue();
+    const float predelay = predelay_smoothed.getCurrentValue();
+    const float decay = decay_smoothed.getCurrentValue();
+    const float diffusion = diffusion_smoothed.getCurrentValue();
+    const float modulation = modulation_smoothed.getCurrentValue();
+    const float damping = damping_smoothed.getCurrentValue();
+    const float early = early_smoothed.getCurrentValue();
+
+    size_smoothed.skip(num_samples);
+    predelay_smoothed.skip(num_samples);
+    decay_smoothed.skip(num_samples);
+    diffusion_smoothed.skip(num_samples);
+    modulation_smoothed.skip(num_samples);
+    damping_smoothed.skip(num_samples);
+    early_smoothed.skip(num_samples);
+
+    if (size != size_smoothed.getCurrentValue() || predelay != predelay_smoothed.getCurrentValue()
+        || decay != decay_smoothed.getCurrentValue() || diffusion != diffusion_smoothed.getCurrentValue()
+        || modulation != modulation_smoothed.getCurrentValue() || damping != damping_smoothed.getCurrentValue()
+        || early != early_smoothed.getCurrentValue()) {
+        apply_network_settings();
+    }
 
-    juce::AudioBuffer<float> output = juce::AudioBuffer<float>(numChannels, buffer.getNumSamples());
-    output.clear();
+    update_quality(num_samples);
+}
 
-    juce::AudioBuffer<float> live_clone = juce::AudioBuffer<float>(numChannels, buffer.getNumSamples());
-    live_clone.makeCopyOf(buffer);
+ReverbTier LearningLiveProcessingAudioProcessor::requested_tier() const
+{
+    return static_cast<ReverbTier>(juce::jlimit(0, num_reverb_tiers - 1, juce::roundToInt(quality_parameter->load())));
+}
 
-    int channel = 0;
+// Starts and finishes Quality switches, between quanta. The pipeline's
+// latency depends on the stage count, so while it runs a switch waits for
+// the next prepareToPlay. Neither end allocates or frees anything here.
+void LearningLiveProcessingAudioProcessor::update_quality(int num_samples)
+{
+    // The new tier has filled in, so the crossfade starts
+    if (outgoing_network != nullptr && quality_onset_samples > 0) {
+        quality_onset_samples -= num_samples;
+        if (quality_onset_samples <= 0)
+            quality_fade.setTargetValue(1.0f);
+    }
 
-    // Apply latest delay buffer data to live signal clone
-    for (int sample = 0; sample < buffer.getNumSamples(); sample++) {
-        float delay_data = f_delay_buffer.getSample(channel, sample + f_samples_delayed);
-        live_clone.addSample(channel, sample, delay_data);
+    if (outgoing_network != nullptr && quality_onset_samples <= 0 && !quality_fade.isSmoothing())
+        retire_outgoing_network();
+
+    // Only once the timer has prepared the requested tier and offered it,
+    // and has taken back the last one retired
+    const auto tier = requested_tier();
+    int offered = static_cast<int>(tier);
+    if (tier != network_tier && outgoing_network == nullptr && retired_tier.load() < 0 && !pipeline.isRunning()
+        && offered_tier.compare_exchange_strong(offered, -1)) {
+        outgoing_network = network;
+        outgoing_tier = network_tier;
+        quality_fade.setCurrentAndTargetValue(0.0f);
+
+        network_tier = tier;
+        network = engines[static_cast<size_t>(tier)].get();
+        apply_network_settings();
+
+        // It is silent, so its reads start where the settings put them rather than gliding there
+        network->resetReads();
+        quality_onset_samples = juce::jmax(network->getFeedforwardSamples() + network->getLoopSamples(), 1);
     }
 
-    // Decrease gain on live data
-    for (int sample = 0; sample < live_clone.getNumSamples(); sample++) {
-        float dropped_gain = live_clone.getSample(channel, sample);
+    fade_start = quality_fade.getCurrentValue();
+    quality_fade.skip(num_samples);
+    fade_end = quality_fade.getCurrentValue();
+}
+
+// Faded out, or cut short by falling asleep. The audio thread is done with
+// it, so it goes back to the timer to be released.
+void LearningLiveProcessingAudioProcessor::retire_outgoing_network()
+{
+    outgoing_network = nullptr;
+    retired_tier = static_cast<int>(outgoing_tier);
+}
 
-        // Reduce gain of delayed sample when writing
-        dropped_gain = dropped_gain * juce::Decibels::decibelsToGain(-1.8f);
+// Message thread. Every allocation a Quality switch needs happens here: the
+// tier the parameter asks for is prepared and offered to the audio thread,
+// and the tier it retires is released.
+void LearningLiveProcessingAudioProcessor::timerCallback()
+{
+    const juce::ScopedLock tier_scope(tier_lock);
 
-        live_clone.setSample(channel, sample, dropped_gain);
+    const int retired = retired_tier.exchange(-1);
+    if (retired >= 0) {
+        engines[static_cast<size_t>(retired)]->release();
+        audio_tiers &= ~(1 << retired);
     }
 
-    // Apply householder to latest delay buffer
-    householderMix8Channels(live_clone);
+    const int requested = static_cast<int>(requested_tier());
 
-    // Write the live data + delay buffer data to the beginning of the actual delay_data buffer
-    for (int sample = 0; sample < live_clone.getNumSamples(); sample++) {
-        float delayed_sample = live_clone.getSample(channel, sample);
+    // Withdrawn if the parameter has moved on before the audio thread took it
+    if (pending_tier >= 0) {
+        int offered = pending_tier;
+        if (pending_tier != requested && offered_tier.compare_exchange_strong(offered, -1))
+            engines[static_cast<size_t>(pending_tier)]->release();
+        else if (offered_tier.load() >= 0)
+            return;
+        else
+            audio_tiers |= 1 << pending_tier;
 
-        f_delay_buffer.setSample(channel, sample, delayed_sample);
+        pending_tier = -1;
     }
 
-    // Send latest delay buffer data to output
-    for (int sample = 0; sample < buffer.getNumSamples(); sample++) {
-        float delay_data = f_delay_buffer.getSample(channel, sample + f_samples_delayed);
-        output.addSample(channel, sample, delay_data);
-    }
+    // Nothing is switched to before prepareToPlay, nor while the pipeline runs.
+    // A tier the audio thread still holds, like one switched back to while
+    // fading out, waits until it comes back.
+    if (!storage_prepared || storage_pipelined || (audio_tiers & (1 << requested)) != 0)
+        return;
 
-    // Shift delay buffer data forward by one buffer size
-    for (int sample = f_delay_buffer.getNumSamples() - 1; sample >= samples_per_block; sample--) {
-        float prev_data = f_delay_buffer.getSample(channel, sample - samples_per_block);
-        f_delay_buffer.setSample(channel, sample, prev_data);
-    }
+    auto& engine = *engines[static_cast<size_t>(requested)];
+    engine.prepare(network_rate);
+    engine.clear();
 
-    return output;
+    pending_tier = requested;
+    offered_tier = requested;
 }
 
-juce::AudioBuffer<float> LearningLiveProcessingAudioProcessor::create_delays2(juce::AudioBuffer<float>& input, int diff) {
-
-    // Create output buffer and clear its contents
-    juce::AudioBuffer<float> output = juce::AudioBuffer<float>(numChannels, input.getNumSamples());
-    output.clear();
+// Gain of the new tier at fade, the outgoing one's being crossfade_gain(1 - fade).
+// Their squares sum to one, so uncorrelated tails keep their combined level.
+float LearningLiveProcessingAudioProcessor::crossfade_gain(float fade)
+{
+    return std::sin(fade * juce::MathConstants<float>::halfPi);
+}
 
-    // For each individual channel
-    for (int channel = 0; channel < input.getNumChannels(); channel++) {
+// The outgoing tier on the same pre-delayed input as the current one,
+// decoded into outgoing_output. Its time only shows in the block stage, so
+// the per-stage breakdown stays the current tier's.
+void LearningLiveProcessingAudioProcessor::run_outgoing_network(int num_samples)
+{
+    float* frames = scratch.get(outgoing_split_slot);
+    float* scratch_frames = scratch.get(outgoing_scratch_slot);
+    float* looped = scratch.get(outgoing_final_slot);
 
-        // Calculate where latest input data should be written to in delay buffer (sooner for delays shorter than max delay)
-        int start_offset = max_delays_in_samples[diff] - channel_samples_delayed[diff][channel];
+    outgoing_network->split(predelayed_input.getReadPointer(0), predelayed_input.getReadPointer(1), frames);
 
-        // Write the latest input data to its corresponding delay buffer
-        for (int sample = 0; sample < input.getNumSamples(); sample++) {
-            float delayed_sample = input.getSample(channel, sample);
+    for (int diff = 0; diff < outgoing_network->getNumStages(); diff++) {
+        outgoing_network->diffuse(diff, frames, scratch_frames);
+        std::swap(frames, scratch_frames);
+    }
 
-            // Reduce gain of delayed sample when writing to the 
-            //delayed_sample = delayed_sample * juce::Decibels::decibelsToGain(-6.0);
+    outgoing_network->feedback(frames, looped, scratch_frames);
 
-            delay_buffers[diff].setSample(channel, sample + start_offset, delayed_sample);
-        }
+    outgoing_output.clear(0, num_samples);
+    outgoing_network->decode(frames, looped, outgoing_output.getWritePointer(0), outgoing_output.getWritePointer(1), num_samples);
+}
 
-        // Send latest delay buffer data to output
-        for (int sample = 0; sample < input.getNumSamples(); sample++) {
-            float delay_data = delay_buffers[diff].getSample(channel, sample + max_delays_in_samples[diff]);
-            output.addSample(channel, sample, delay_data);
-        }
+// Turns the smoothed parameter values into delays and gains
+void LearningLiveProcessingAudioProcessor::apply_network_settings()
+{
+    const auto settings = network_settings();
+    network->applySettings(settings);
 
-        // Shift delay buffer data forward by one buffer size
-        for (int sample = delay_buffers[diff].getNumSamples() - 1; sample >= (start_offset + samples_per_block); sample--) {
-            float prev_data = delay_buffers[diff].getSample(channel, sample - samples_per_block);
-            delay_buffers[diff].setSample(channel, sample, prev_data);
-        }
+    if (outgoing_network != nullptr) {
+        outgoing_network->applySettings(settings);
     }
+    predelay_samples = static_cast<int>(std::round(predelay_smoothed.getCurrentValue() * 0.001 * network_rate));
 
-    return output;
+    early_reflections.setSize(size_smoothed.getCurrentValue());
+    early_level = early_smoothed.getCurrentValue();
 
+    // Longest path from the input to the feedback loop or the output. The
+    // early reflections feed the diffusers, so the latest one adds to it.
+    // A pre-delay still gliding down counts from where it is.
+    const int longest_predelay = juce::jmax(predelay_samples, static_cast<int>(std::ceil(predelay_position)));
+    flush_samples = (longest_predelay + early_reflections.getLongestDelay() + network->getFeedforwardSamples()) * rate_factor
+                    + dry_delay_samples;
 }
 
-juce::AudioBuffer<float> LearningLiveProcessingAudioProcessor::shuffle(juce::AudioBuffer<float>& input, int diff) {
-    juce::AudioBuffer<float> output(input.getNumChannels(), input.getNumSamples());
+NetworkSettings LearningLiveProcessingAudioProcessor::network_settings() const
+{
+    NetworkSettings settings;
+    settings.size = size_smoothed.getCurrentValue();
+    settings.decay = decay_smoothed.getCurrentValue();
+    settings.damping = damping_smoothed.getCurrentValue();
+    settings.diffusion = diffusion_smoothed.getCurrentValue();
+    settings.modulation = modulation_smoothed.getCurrentValue();
+    return settings;
+}
 
-    for (int channel = 0; channel < input.getNumChannels(); channel++) {
-        output.copyFrom(channel, 0, input, swaps[diff][channel], 0, input.getNumSamples());
+// The wet path starts predelay_samples late; the dry path is not pre-delayed.
+// A new pre-delay is glided to, like the network's delays.
+void LearningLiveProcessingAudioProcessor::apply_predelay(const juce::AudioBuffer<float>& source, int num_samples)
+{
+    const float start = predelay_position;
+    predelay_position = DelayLine::glideTowards(start, static_cast<float>(predelay_samples), num_samples);
 
-        float* buffer = output.getWritePointer(channel);
-        for (int sample = 0; sample < output.getNumSamples(); sample++) {
-            buffer[sample] *= polarities[diff][channel];
-        }
-    }
+    for (int channel = 0; channel < 2; ++channel) {
+        predelay_lines[channel].write(source.getReadPointer(channel), num_samples);
 
-    return output;
-    
+        if (start == predelay_position)
+            predelay_lines[channel].read(predelayed_input.getWritePointer(channel), num_samples, predelay_samples);
+        else
+            predelay_lines[channel].readGliding(predelayed_input.getWritePointer(channel), num_samples, start, predelay_position);
+    }
 }
 
-// This doesn't work for some reason :(
-juce::AudioBuffer<float> LearningLiveProcessingAudioProcessor::applyHadamardMatrix(juce::AudioBuffer<float>& buffer)
+// Taps the pre-delayed input. The ring is kept current at any level, so
+// turning the reflections up never brings back old input.
+void LearningLiveProcessingAudioProcessor::apply_early_reflections(int num_samples)
 {
-    juce::AudioBuffer<float> output = juce::AudioBuffer<float>(buffer.getNumChannels(), buffer.getNumSamples());
-    output.clear();
+    early_reflections.push(predelayed_input.getReadPointer(0), predelayed_input.getReadPointer(1), num_samples);
+
+    if (early_level <= 0.0f)
+        return;
 
-    float H[4][4] = {
-    { 1,  1,  1,  1 },
-    { 1, -1,  1, -1 },
-    { 1,  1, -1, -1 },
-    { 1, -1, -1,  1 }
-    };
+    early_output.clear(0, num_samples);
+    early_reflections.addTo(early_output.getWritePointer(0), early_output.getWritePointer(1), num_samples, early_level, early_output_delay);
 
-    // Normalize matrix
-    for (int i = 0; i < 4; i++) {
-        for (int j = 0; j < 4; j++) {
-            H[i][j] /= sqrt(4);
+    // The diffusers get the reflections without the pipeline's delay
+    if (early_output_delay == 0) {
+        for (int channel = 0; channel < 2; ++channel) {
+            predelayed_input.addFrom(channel, 0, early_output, channel, 0, num_samples);
         }
     }
+    else {
+        early_reflections.addTo(predelayed_input.getWritePointer(0), predelayed_input.getWritePointer(1), num_samples, early_level, 0);
+    }
+}
 
-    // Applying hadamard into output
-    // For each column of all input vectors
-    for (int sample = 0; sample < buffer.getNumSamples(); sample++) {
+// At the full rate the network reads the queued input directly
+const juce::AudioBuffer<float>& LearningLiveProcessingAudioProcessor::network_rate_input(int num_samples)
+{
+    if (rate_factor == 1)
+        return fifo_input;
 
-        // Solve for the value of each row of that column
-        for (int row = 0; row < 4; row++) {
-            float summed_value = 0;
+    for (int channel = 0; channel < 2; ++channel) {
+        resamplers[channel].downsample(fifo_input.getReadPointer(channel), network_input.getWritePointer(channel), num_samples);
+    }
+    return network_input;
+}
 
-            // Calculate each row value in vector times each column value from respective row in matrix
-            for (int i = 0; i < 4; i++) {
-                float vector_val = buffer.getSample(i, sample);
-                float matrix_val = H[row][i];
+// Brings the wet signal in network_output back to the host rate, on top of the dry
+void LearningLiveProcessingAudioProcessor::add_upsampled_output(int num_samples)
+{
+    if (rate_factor == 1)
+        return;
 
-                summed_value += (vector_val * matrix_val);
-            }
+    for (int channel = 0; channel < 2; ++channel) {
+        resamplers[channel].upsample(network_output.getReadPointer(channel), upsampled_output.getWritePointer(channel), num_samples);
+        fifo_output.addFrom(channel, 0, upsampled_output, channel, 0, fifo_size);
+    }
+}
 
-            output.setSample(row, sample, summed_value);
+// The dry signal at the host rate, held back by dry_delay_samples to line up with the wet one
+void LearningLiveProcessingAudioProcessor::write_dry()
+{
+    for (int channel = 0; channel < 2; ++channel) {
+        if (dry_delay_samples > 0) {
+            dry_delay_lines[channel].write(fifo_input.getReadPointer(channel), fifo_size);
+            dry_delay_lines[channel].read(fifo_output.getWritePointer(channel), fifo_size, dry_delay_samples);
+        }
+        else {
+            fifo_output.copyFrom(channel, 0, fifo_input, channel, 0, fifo_size);
         }
     }
-    return output;
 }
 
-// works! thanks deepseek!
-void hadamardMix4Channels(juce::AudioBuffer<float>& buffer)
+//==============================================================================
+// Checks the queued input. Any signal above the threshold wakes the reverb
+// straight away, before this quantum is processed.
+bool LearningLiveProcessingAudioProcessor::input_is_silent()
 {
-    // Ensure we have exactly 4 channels
-    jassert(buffer.getNumChannels() == 4);
+    if (fifo_input.getMagnitude(0, fifo_size) > silence_threshold) {
+        silent_input_samples = 0;
+        quiet_output_samples = 0;
+        asleep = false;
+        falling_asleep = false;
+        return false;
+    }
 
-    const int numSamples = buffer.getNumSamples();
+    silent_input_samples = juce::jmin(silent_input_samples + fifo_size, std::numeric_limits<int>::max() - fifo_size);
+    return true;
+}
 
-    // Get write pointers for all channels
-    float* ch0 = buffer.getWritePointer(0);
-    float* ch1 = buffer.getWritePointer(1);
-    float* ch2 = buffer.getWritePointer(2);
-    float* ch3 = buffer.getWritePointer(3);
+// Goes to sleep once nothing above the threshold can come out any more: the
+// input has been silent long enough to flush the pre-delay and diffusion, and
+// the output has stayed quiet for a whole feedback loop since, which is every
+// sample stored in the loop passing the output once.
+void LearningLiveProcessingAudioProcessor::update_sleep_state()
+{
+    if (asleep)
+        return;
 
-    // Hadamard mixing matrix with scaling factor 1/sqrt(4) = 0.5
-    for (int i = 0; i < numSamples; ++i)
-    {
-        // Read original samples
-        const float in0 = ch0[i];
-        const float in1 = ch1[i];
-        const float in2 = ch2[i];
-        const float in3 = ch3[i];
+    if (falling_asleep) {
+        continue_falling_asleep();
+        return;
+    }
 
-        // Apply Hadamard matrix mixing
-        ch0[i] = (in0 + in1 + in2 + in3) * 0.5f;
-        ch1[i] = (in0 - in1 + in2 - in3) * 0.5f;
-        ch2[i] = (in0 + in1 - in2 - in3) * 0.5f;
-        ch3[i] = (in0 - in1 - in2 + in3) * 0.5f;
+    if (fifo_output.getMagnitude(0, fifo_size) > silence_threshold)
+        quiet_output_samples = 0;
+    else
+        quiet_output_samples = juce::jmin(quiet_output_samples + fifo_size, std::numeric_limits<int>::max() - fifo_size);
+
+    const int loop_samples = network->getLoopSamples() * rate_factor;
+    if (silent_input_samples >= flush_samples + loop_samples && quiet_output_samples >= loop_samples) {
+        // What is left is below the threshold, so the lines can simply be
+        // zeroed. No tick is started while falling asleep, so once the
+        // workers are idle the network is the audio thread's alone.
+        if (pipeline.isRunning())
+            pipeline.waitForStages();
+
+        // A Quality switch in progress ends here
+        if (outgoing_network != nullptr)
+            retire_outgoing_network();
+
+        falling_asleep = true;
+        sleep_cleared = 0;
     }
 }
 
-void hadamardMix8Channels(juce::AudioBuffer<float>& buffer)
+// Zeroes the lines a piece per block, because a whole tier's lines take
+// milliseconds to clear. The network is
+// already skipped, and the reverb is asleep once the last piece is done.
+void LearningLiveProcessingAudioProcessor::continue_falling_asleep()
 {
-    // Ensure we have exactly 8 channels
-    jassert(buffer.getNumChannels() == 8);
-
-    const int numSamples = buffer.getNumSamples();
-    const float scale = 1.0f / std::sqrt(8.0f); // ~0.353553391f
+    sleep_cleared = network->clearPart(sleep_cleared, sleep_bytes_per_quantum);
+    if (sleep_cleared < network->getDelayBytes())
+        return;
 
-    // Get write pointers for all channels
-    float* ch0 = buffer.getWritePointer(0);
-    float* ch1 = buffer.getWritePointer(1);
-    float* ch2 = buffer.getWritePointer(2);
-    float* ch3 = buffer.getWritePointer(3);
-    float* ch4 = buffer.getWritePointer(4);
-    float* ch5 = buffer.getWritePointer(5);
-    float* ch6 = buffer.getWritePointer(6);
-    float* ch7 = buffer.getWritePointer(7);
-
-    for (int i = 0; i < numSamples; ++i)
-    {
-        // Read original samples
-        const float in0 = ch0[i];
-        const float in1 = ch1[i];
-        const float in2 = ch2[i];
-        const float in3 = ch3[i];
-        const float in4 = ch4[i];
-        const float in5 = ch5[i];
-        const float in6 = ch6[i];
-        const float in7 = ch7[i];
-
-        // Apply 8x8 Sylvester Hadamard matrix
-        ch0[i] = (in0 + in1 + in2 + in3 + in4 + in5 + in6 + in7) * scale;
-        ch1[i] = (in0 - in1 + in2 - in3 + in4 - in5 + in6 - in7) * scale;
-        ch2[i] = (in0 + in1 - in2 - in3 + in4 + in5 - in6 - in7) * scale;
-        ch3[i] = (in0 - in1 - in2 + in3 + in4 - in5 - in6 + in7) * scale;
-        ch4[i] = (in0 + in1 + in2 + in3 - in4 - in5 - in6 - in7) * scale;
-        ch5[i] = (in0 - in1 + in2 - in3 - in4 + in5 - in6 + in7) * scale;
-        ch6[i] = (in0 + in1 - in2 - in3 - in4 - in5 + in6 + in7) * scale;
-        ch7[i] = (in0 - in1 - in2 + in3 - in4 + in5 + in6 - in7) * scale;
-    }
-}
-
-juce::AudioBuffer<float> LearningLiveProcessingAudioProcessor::diffuse(juce::AudioBuffer<float>& buffer, int diff_count) {
-    juce::AudioBuffer<float> output;
-    output.makeCopyOf(buffer);
+    clear_wet_lines();
+    falling_asleep = false;
+    asleep = true;
+}
 
-    for (int diff = 0; diff < diff_count; diff++) {
-        juce::AudioBuffer<float> d = create_delays2(output, diff);
-        juce::AudioBuffer<float> s = shuffle(d, diff);
-        hadamardMix8Channels(s);
-        output = s;
-    }
+// While asleep or falling asleep the network is skipped and only the dry
+// signal goes through, with the same latency as when awake
+void LearningLiveProcessingAudioProcessor::pass_dry_through()
+{
+    StageProfiler::ScopedProbe probe(profiler, profile_output, fifo_size / rate_factor);
+    write_dry();
+}
 
-    return output;
+float* LearningLiveProcessingAudioProcessor::pipeline_frames(int boundary, juce::int64 hop) const
+{
+    return pipeline_scratch.get(boundary_slots + 2 * boundary + static_cast<int>(hop & 1));
 }
 
-void LearningLiveProcessingAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+// Audio thread side of the pipeline: feeds hop `tick` in and takes hop
+// (tick - pipeline_stages) out, while the workers run everything in between
+void LearningLiveProcessingAudioProcessor::process_pipeline_hop()
 {
-    juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
-    auto totalNumOutputChannels = getTotalNumOutputChannels();
+    const int num_samples = pipeline_hop;
 
-    // In case we have more outputs than inputs, this code clears any output
-    // channels that didn't contain input data, (because these aren't
-    // guaranteed to be empty - they may contain garbage).
-    // This is here to avoid people getting screaming feedback
-    // when they first compile a plugin, but obviously you don't need to keep
-    // this code if your algorithm always overwrites all the output channels.
-    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
+    const juce::int64 tick = pipeline.waitForStages();
+    const juce::int64 finished_hop = tick - pipeline_stages;
 
-    // This is the place where you'd normally do the guts of your plugin's
-    // audio processing...
-    // Make sure to reset the state if your inner loop is processing
-    // the samples and the outer loop is handling the channels.
-    // Alternatively, you can process the samples with the channels
-    // interleaved by keeping the same state.
+    // No stage is running now, so the settings they read can change
+    advance_parameters(num_samples);
 
-    juce::dsp::AudioBlock<float> block{ buffer };
+    float* multichannel_data = pipeline_frames(0, tick);
+    {
+        StageProfiler::ScopedProbe probe(profiler, profile_input, num_samples);
+        apply_predelay(network_rate_input(num_samples), num_samples);
+        apply_early_reflections(num_samples);
 
-    for (int input_channel = 0; input_channel < 1; ++input_channel) {
+        for (int start = 0; start < num_samples; start += internal_quantum) {
+            split_input(predelayed_input, start, multichannel_data + start * network->getNumChannels());
+        }
+    }
+
+    {
+        // The dry signal, held back to line up with the hop leaving the pipeline
+        StageProfiler::ScopedProbe probe(profiler, profile_output, num_samples);
+        write_dry();
+
+        const float* final_delayed = pipeline_frames(pipeline_stages, finished_hop);
+        const float* diffused_signal = pipeline_scratch.get(diffused_slots + static_cast<int>(finished_hop & 1));
+        decode_output(diffused_signal, final_delayed, num_samples);
+        add_upsampled_output(num_samples);
+    }
 
-        //juce::AudioBuffer<float> demo = juce::AudioBuffer<float>(4, 1);
-        //demo.setSample(0, 0, 1);
-        //demo.setSample(1, 0, 2);
-        //demo.setSample(2, 0, -1);
-        //demo.setSample(3, 0, 3);
+    pipeline.startTick(tick);
+}
+
+// Worker side: stage s runs diffusion s, the last stage runs the final delay.
+// Each stage is the only user of its delay lines, so they need no locking.
+void LearningLiveProcessingAudioProcessor::runPipelineStage(int stage, juce::int64 tick)
+{
+    const juce::int64 hop = tick - stage;
 
-        //juce::AudioBuffer<float> ht = applyHadamardMatrix(demo);
+    // Until the first hop reaches this stage there is nothing to do, and
+    // running anyway would put its LFOs out of step with the serial path.
+    // The slots it would have written were cleared when the pipeline started.
+    if (hop < 1)
+        return;
 
-        //float t1 = ht.getSample(0, 0);
-        //float t2 = ht.getSample(1, 0);
-        //float t3 = ht.getSample(2, 0);
-        //float t4 = ht.getSample(3, 0);
-        
-        juce::AudioBuffer<float> multichannel_data = split_input(buffer, input_channel);
-        juce::AudioBuffer<float> diffused_signal = diffuse(multichannel_data, 3);
-        juce::AudioBuffer<float> final_delayed = final_delay(diffused_signal);
+    const float* input = pipeline_frames(stage, hop);
+    float* output = pipeline_frames(stage + 1, hop);
 
-        //buffer.clear(0, 0, buffer.getNumSamples());
-        //buffer.clear(1, 0, buffer.getNumSamples());
+    // Each stage's timings are only written by whichever thread claimed its
+    // job, the worker or a waiting audio thread, never both at once. The last
+    // stage is the final delay whatever the tier's number of diffusions.
+    const int profile_stage = stage < network->getNumStages() ? profile_diffusion + stage : profile_final_delay;
+    StageProfiler::ScopedProbe probe(profiler, profile_stage, pipeline_hop);
 
-        for (int channel = 0; channel < numChannels; channel++) {
-            buffer.addFrom(input_channel, 0, final_delayed, channel, 0, block.getNumSamples());
-            buffer.addFrom(input_channel, 0, diffused_signal, channel, 0, block.getNumSamples());
+    const int num_channels = network->getNumChannels();
 
-            //if (channel == 0) buffer.copyFrom(input_channel, 0, output, channel, 0, block.getNumSamples());
-            //else buffer.addFrom(input_channel, 0, output, channel, 0, block.getNumSamples());
+    if (stage < network->getNumStages()) {
+        for (int start = 0; start < pipeline_hop; start += internal_quantum) {
+            const int offset = start * num_channels;
+            network->diffuse(stage, input + offset, output + offset);
         }
+        return;
     }
 
-    // Make input signal stereo
-    buffer.copyFrom(1, 0, buffer, 0, 0, buffer.getNumSamples());
+    // The audio thread reads the diffused hop after the next stage has moved on,
+    // so it gets its own copy. The serial scratch slots are free in this mode.
+    float* diffused = pipeline_scratch.get(diffused_slots + static_cast<int>(hop & 1));
+    juce::FloatVectorOperations::copy(diffused, input, pipeline_hop * num_channels);
 
+    float* live_clone = scratch.get(diffuse_scratch_slot);
+    for (int start = 0; start < pipeline_hop; start += internal_quantum) {
+        const int offset = start * num_channels;
+        network->feedback(input + offset, output + offset, live_clone);
+    }
 }
 
 //==============================================================================
@@ -605,12 +1157,33 @@ void LearningLiveProcessingAudioProcessor::getStateInformation (juce::MemoryBloc
     // You should use this method to store your parameters in the memory block.
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
+    auto state = parameters.copyState();
+    state.setProperty(topology_seed_property, static_cast<juce::int64>(topology_seed), nullptr);
+    std::unique_ptr<juce::XmlElement> xml (state.createXml());
+    copyXmlToBinary (*xml, destData);
 }
 
 void LearningLiveProcessingAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
+    std::unique_ptr<juce::XmlElement> xmlState (getXmlFromBinary (data, sizeInBytes));
+
+    if (xmlState != nullptr && xmlState->hasTagName (parameters.state.getType())) {
+        auto state = juce::ValueTree::fromXml (*xmlState);
+
+        // Sessions saved before the seed was stored keep this instance's own
+        if (state.hasProperty(topology_seed_property)) {
+            const auto seed = static_cast<juce::uint32>(static_cast<juce::int64>(state.getProperty(topology_seed_property)));
+            state.removeProperty(topology_seed_property, nullptr);
+
+            if (seed != topology_seed) {
+                setTopologySeed(seed);
+            }
+        }
+
+        parameters.replaceState (state);
+    }
 }
 
 //==============================================================================
@@ -9,15 +9,39 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "ScratchArena.h"
+#include "DelayLine.h"
+#include "EarlyReflections.h"
+#include "ReverbNetwork.h"
+#include "StagePipeline.h"
+#include "HalfBandFilter.h"
+#include "StageProfiler.h"
+#include "AnalysisTap.h"
+
+// Parameter IDs, shared with the editor's attachments
+namespace ParameterIds
+{
+    inline constexpr const char* size = "size";
+    inline constexpr const char* predelay = "predelay";
+    inline constexpr const char* decay = "decay";
+    inline constexpr const char* diffusion = "diffusion";
+    inline constexpr const char* modulation = "modulation";
+    inline constexpr const char* damping = "damping";
+    inline constexpr const char* early = "early";
+    inline constexpr const char* quality = "quality";
+}
 
 //==============================================================================
 /**
 */
-class LearningLiveProcessingAudioProcessor  : public juce::AudioProcessor
+class LearningLiveProcessingAudioProcessor  : public juce::AudioProcessor,
+                                              private StagePipeline::Client,
+                                              private juce::Timer
 {
 public:
     //==============================================================================
-    LearningLiveProcessingAudioProcessor();
+    // tier picks the density of the reverb network against its CPU cost
+    explicit LearningLiveProcessingAudioProcessor(ReverbTier tier = ReverbTier::standard);
     ~LearningLiveProcessingAudioProcessor() override;
 
     //==============================================================================
@@ -53,42 +77,350 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
-    juce::AudioBuffer<float> split_input(juce::AudioBuffer<float>& buffer, int input_channel);
-    juce::AudioBuffer<float> create_delays2(juce::AudioBuffer<float>& buffer, int diff);
-    juce::AudioBuffer<float> shuffle(juce::AudioBuffer<float>& input, int diff);
-    juce::AudioBuffer<float> applyHadamardMatrix(juce::AudioBuffer<float>& buffer);
-    juce::AudioBuffer<float> diffuse(juce::AudioBuffer<float>& buffer, int diff_count);
-    juce::AudioBuffer<float> final_delay(juce::AudioBuffer<float>& buffer);
+    juce::AudioProcessorValueTreeState& getParameters() { return parameters; }
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+
+    // The network always runs on exactly internal_quantum samples, whatever
+    // block size the host uses. processBlock queues host audio into quanta
+    // and every kernel below sees a compile-time frame count.
+    static constexpr int internal_quantum = 32;
+
+    // The network runs on interleaved frames (one sample of every channel per
+    // frame). Every stage writes into caller-provided blocks from the scratch
+    // arena, so nothing here allocates once prepareToPlay has run.
+    void process_quantum();
+    void split_input(const juce::AudioBuffer<float>& buffer, int start_sample, float* output);
+    void decode_output(const float* diffused, const float* final_delayed, int num_samples);
+    void diffuse(float* frames, float* scratch_frames);
+
+    // Below this level (as a gain) input counts as silent and the tail as
+    // finished. The reverb sleeps once both are true, and the reported tail
+    // length is the time it takes to decay to this level.
+    void setSilenceThreshold(float gain) { silence_threshold = gain; }
+
+    // Optional mode that runs each diffusion stage and the final delay on its
+    // own worker thread, one hop apart. It spreads the work across cores for
+    // pipeline_stages extra hops of latency, which is reported to the host.
+    // Takes effect at the next prepareToPlay.
+    void setPipelinedDiffusion(bool should_pipeline);
+    bool isPipelinedDiffusion() const { return pipelined_diffusion; }
+
+    // Optional mode for high sample rates that runs the network at 44.1 or
+    // 48 kHz: the wet input is decimated by 2 or 4 with half-band filters and
+    // the wet output interpolated back up. The dry signal stays at the host
+    // rate and is delayed to match; the added latency is reported to the host.
+    // Takes effect at the next prepareToPlay.
+    void setReducedRateEngine(bool should_reduce);
+    bool isReducedRateEngine() const { return reduced_rate_engine; }
+
+    // Which specialisation of the network runs: eco (4 channels, 2 diffusion
+    // stages), standard (8 x 3) or dense (16 x 4). This is the Quality
+    // parameter (Eco, Standard, High), and setting the tier sets it. Only the
+    // current tier holds delay memory. A change while playing has the new
+    // tier prepared on the message thread, then crossfades to it once it has
+    // filled in. In pipelined mode, whose latency depends on the stage
+    // count, a change waits for the next prepareToPlay.
+    void setNetworkTier(ReverbTier tier);
+    ReverbTier getNetworkTier() const { return network_tier.load(); }
+
+    // Optional mode that stores the network's delay lines as 16 bit half
+    // floats, converted on every write and read, with all arithmetic still in
+    // float. It halves the lines' memory, which matters most for the dense
+    // tier and high rates, for a noise floor about 68 dB below the tail.
+    // Takes effect at the next prepareToPlay.
+    void setHalfPrecisionDelays(bool should_use_half);
+    bool isHalfPrecisionDelays() const { return half_precision_delays; }
+
+    // Bytes the delay lines of the prepared networks take together: the
+    // current tier's, plus the other one while a Quality switch is under way
+    size_t getNetworkDelayBytes() const;
+
+    // The instruction set the network's kernels run on. Every instance starts
+    // on the best one the CPU supports; a lower one, down to the scalar
+    // reference, can be forced to check the others against it. Levels the
+    // CPU lacks fall back to the best it has. Takes effect at the next prepareToPlay.
+    void setSimdLevel(SimdLevel level);
+    SimdLevel getSimdLevel() const { return simd_level; }
+
+    // The seed the network's polarities and channel swaps are generated from.
+    // Every instance starts on its own random seed, which is saved with its
+    // state so a session recalls the same reverb. Instances on the same seed
+    // and tier share one copy of the tables. Safe to call while playing: the
+    // new tables are swapped in between blocks.
+    void setTopologySeed(juce::uint32 seed);
+    juce::uint32 getTopologySeed() const { return topology_seed; }
+
+    // Timing of each part of the network, for the editor's CPU breakdown.
+    // The last stage covers whole host blocks and counts missed deadlines.
+    enum ProfileStage
+    {
+        profile_input = 0,
+        profile_diffusion,
+        profile_final_delay = profile_diffusion + max_diffusion_stages,
+        profile_output,
+        profile_block,
+        num_profile_stages
+    };
+
+    StageProfiler& getProfiler() { return profiler; }
+
+    // Copy of the output for the editor's analysers. Costs the audio thread
+    // one memcpy per channel while an editor is reading it, nothing otherwise.
+    AnalysisTap& getAnalysisTap() { return analysis_tap; }
 
 private:
 
     // REVERB PRIVATE GLOBALS
 
-    double sample_rate;
-    int numChannels = 8;
-    int samples_per_block;
+    double sample_rate = 0.0;
+    int samples_per_block = 0;
+
+    // Rate the network runs at, sample_rate / rate_factor. Every delay,
+    // smoother and setting of the network is in samples at this rate.
+    double network_rate = 0.0;
+
+    // What the delay lines and buffers were last sized for. releaseResources
+    // frees them all, and prepareToPlay only reallocates when this changes.
+    bool storage_prepared = false;
+    bool storage_pipelined = false;
+    bool storage_reduced_rate = false;
+    ReverbTier storage_tier = ReverbTier::standard;
+    bool storage_half_precision = false;
+    SimdLevel storage_simd_level = SimdLevel::scalar;
+
+    void prepare_storage(int rate_stages);
+    void clear_state();
+    void clear_wet_lines();
+
+    // REVERB NETWORK
+
+    // The diffusers and the feedback delay network, one per tier, compiled
+    // for the delay lines' sample type and the instruction set. Only the
+    // current tier's is prepared, and the outgoing one's during a Quality
+    // switch. A new sample type or instruction set rebuilds them all at the
+    // next prepareToPlay.
+    void create_engines();
+
+    // A Quality switch changes this on the audio thread, and the message
+    // thread reads it for the tail length, so it is atomic where network isn't
+    std::atomic<ReverbTier> network_tier { ReverbTier::standard };
+    bool half_precision_delays = false;
+    SimdLevel simd_level = getSupportedSimdLevel();
+    juce::uint32 topology_seed = 0;
+    std::array<std::unique_ptr<ReverbEngine>, num_reverb_tiers> engines;
+
+    // The engine of network_tier
+    ReverbEngine* network = nullptr;
+
+    // Property of the saved state that holds topology_seed
+    static constexpr const char* topology_seed_property = "topologySeed";
+
+    // PARAMETERS
+
+    static constexpr float min_size = 0.25f;
+    static constexpr float max_size = ReverbEngine::max_size;
+    static constexpr float max_predelay_ms = 250.0f;
+    static constexpr double parameter_ramp_seconds = 0.05;
+
+    juce::AudioProcessorValueTreeState parameters;
+
+    std::atomic<float>* size_parameter = nullptr;
+    std::atomic<float>* predelay_parameter = nullptr;
+    std::atomic<float>* decay_parameter = nullptr;
+    std::atomic<float>* diffusion_parameter = nullptr;
+    std::atomic<float>* modulation_parameter = nullptr;
+    std::atomic<float>* damping_parameter = nullptr;
+    std::atomic<float>* early_parameter = nullptr;
+    std::atomic<float>* quality_parameter = nullptr;
+
+    juce::SmoothedValue<float> size_smoothed;
+    juce::SmoothedValue<float> predelay_smoothed;
+    juce::SmoothedValue<float> decay_smoothed;
+    juce::SmoothedValue<float> diffusion_smoothed;
+    juce::SmoothedValue<float> modulation_smoothed;
+    juce::SmoothedValue<float> damping_smoothed;
+    juce::SmoothedValue<float> early_smoothed;
+
+    void advance_parameters(int num_samples);
+    void apply_network_settings();
+    void apply_predelay(const juce::AudioBuffer<float>& source, int num_samples);
+
+    // Derived from the smoothed parameters by apply_network_settings. The
+    // stages read the network's settings, so in pipelined mode they only change between ticks.
+    NetworkSettings network_settings() const;
+    int predelay_samples = 0;
+
+    // Where the pre-delay read ended last block, gliding towards predelay_samples
+    float predelay_position = 0.0f;
+
+    // Wet input, held back by the pre-delay
+    std::array<DelayLine, 2> predelay_lines;
+    juce::AudioBuffer<float> predelayed_input;
+
+    // EARLY REFLECTIONS
+
+    // Taps on the pre-delayed input, added to the output and to what the
+    // diffusers take in, both at early_level. The output copy is held back
+    // by early_output_delay network samples, the pipeline's latency, so it
+    // lands with the wet signal rather than ahead of the dry one.
+    void apply_early_reflections(int num_samples);
+
+    EarlyReflections early_reflections;
+    juce::AudioBuffer<float> early_output;
+    float early_level = 0.0f;
+    int early_output_delay = 0;
+
+    // QUALITY SWITCHING
+
+    // After a Quality change both tiers run on the same input. The new one
+    // starts from silence, so it stays muted while the outgoing one plays on
+    // until its longest path, through the diffusers and once round the loop,
+    // has filled in: a few hundred milliseconds, or seconds at the largest
+    // sizes. Then the two crossfade over quality_crossfade_seconds at equal
+    // power, as their tails are uncorrelated, and the outgoing tier is released.
+    static constexpr double quality_crossfade_seconds = 0.1;
+
+    ReverbTier requested_tier() const;
+    void update_quality(int num_samples);
+    void run_outgoing_network(int num_samples);
+    void retire_outgoing_network();
+    static float crossfade_gain(float fade);
+
+    ReverbEngine* outgoing_network = nullptr;
+    ReverbTier outgoing_tier = ReverbTier::standard;
+    juce::AudioBuffer<float> outgoing_output;
+    juce::AudioBuffer<float> incoming_output;
+
+    // Network samples the new tier has left to fill in before the crossfade
+    int quality_onset_samples = 0;
+
+    // 0 to 1 over the crossfade, and its value at the start and end of this quantum
+    juce::SmoothedValue<float> quality_fade;
+    float fade_start = 1.0f;
+    float fade_end = 1.0f;
+
+    // Allocating and locking a tier's lines (19 MB for dense at 192 kHz)
+    // never happens on the audio thread. The timer prepares the tier the
+    // Quality parameter asks for and puts it in offered_tier, and the audio
+    // thread takes it from there when it starts the switch. A tier it has
+    // faded out goes back through retired_tier, and the timer releases it.
+    // Each slot holds a tier index, or -1 when empty.
+    static constexpr int quality_timer_hz = 20;
+
+    void timerCallback() override;
+
+    std::atomic<int> offered_tier { -1 };
+    std::atomic<int> retired_tier { -1 };
+
+    // The timer's side, under tier_lock along with prepareToPlay and
+    // releaseResources: the tier on offer, and a bit per tier the audio
+    // thread holds (the current one, and the outgoing one mid-switch)
+    juce::CriticalSection tier_lock;
+    int pending_tier = -1;
+    int audio_tiers = 0;
+
+    // WORKING STORAGE
+
+    // Slots in the scratch arena. diffuse ping-pongs between the split and
+    // scratch slots, and the feedback network reuses the scratch slot. The
+    // outgoing tier of a Quality switch has its own three.
+    enum ScratchSlot
+    {
+        split_slot = 0,
+        diffuse_scratch_slot,
+        final_output_slot,
+        outgoing_split_slot,
+        outgoing_scratch_slot,
+        outgoing_final_slot,
+        num_scratch_slots
+    };
+
+    ScratchArena scratch;
+
+    // Host audio waiting to fill the next quantum, and the output of the last
+    // one waiting to be handed back. This costs one quantum (at the network
+    // rate) of latency, which is reported to the host.
+    juce::AudioBuffer<float> fifo_input;
+    juce::AudioBuffer<float> fifo_output;
+    int fifo_size = internal_quantum;
+    int fifo_fill = 0;
+
+    // SLEEP MODE
+
+    bool input_is_silent();
+    void update_sleep_state();
+    void continue_falling_asleep();
+    void pass_dry_through();
+
+    float silence_threshold = juce::Decibels::decibelsToGain(-96.0f);
+    bool asleep = false;
+
+    // Between the tail going quiet and asleep: the network is skipped while
+    // its lines are cleared up to sleep_cleared bytes, a piece per block, so
+    // the audio thread never zeroes a whole tier's lines at once
+    static constexpr size_t sleep_bytes_per_quantum = 64 * 1024;
+
+    bool falling_asleep = false;
+    size_t sleep_cleared = 0;
+    int silent_input_samples = 0;
+    int quiet_output_samples = 0;
+
+    // Longest delay from the input to the output or the feedback loop, in host samples
+    int flush_samples = 0;
+
+    // REDUCED RATE ENGINE
+
+    // The network never runs below this rate, so the tail keeps the audible band
+    static constexpr double min_network_rate = 44100.0;
+
+    const juce::AudioBuffer<float>& network_rate_input(int num_samples);
+    void add_upsampled_output(int num_samples);
+    void write_dry();
+
+    bool reduced_rate_engine = false;
+    int rate_factor = 1;
+
+    // One cascade per channel takes the wet input down and the wet output back up
+    std::array<HalfBandCascade, 2> resamplers;
+    juce::AudioBuffer<float> network_input;
+    juce::AudioBuffer<float> network_output;
+    juce::AudioBuffer<float> upsampled_output;
+
+    // How far the dry signal is held back to line up with the wet one: the
+    // resampling round trip plus the pipeline, in host samples
+    int dry_delay_samples = 0;
+    std::array<DelayLine, 2> dry_delay_lines;
+
+    // PIPELINED DIFFUSION
 
-    // DIFFUSE DELAY VARIABLES
+    // One pipeline stage per diffusion plus one for the final delay
+    static constexpr int max_pipeline_stages = max_diffusion_stages + 1;
+    int pipeline_stages = 0;
 
-    std::vector<float> delay_steps = { 0.01f, 0.02f, 0.04f, 0.08f };
-    std::vector<std::vector<float>> delay_times;
-    int diffusion_count = delay_steps.size();
+    void process_pipeline_hop();
+    void runPipelineStage(int stage, juce::int64 tick) override;
+    float* pipeline_frames(int boundary, juce::int64 hop) const;
 
-    std::vector<std::vector<int>> polarities;
-    std::vector<std::vector<int>> swaps;
+    bool pipelined_diffusion = false;
+    int pipeline_hop = internal_quantum;   // in network samples
 
-    std::vector<int> max_delays_in_samples;
-    std::vector<std::vector<int>> channel_samples_delayed;
-    std::vector<std::vector<int>> delay_buf_sizes;
+    // Double buffered frames between the stages. Boundary b is the input of
+    // stage b (boundary 0 is the split input, the last one the final delay
+    // output), and hop h lives in the half given by its parity.
+    enum PipelineSlot
+    {
+        boundary_slots = 0,
+        diffused_slots = boundary_slots + 2 * (max_pipeline_stages + 1),
+        num_pipeline_slots = diffused_slots + 2
+    };
 
-    std::vector<juce::AudioBuffer<float>> delay_buffers;
+    ScratchArena pipeline_scratch;
+    StagePipeline pipeline;
 
+    // PROFILING AND ANALYSIS
 
-    // FINAL DELAY VALUES
-    
-    float f_delay_time = 0.2f;
-    juce::AudioBuffer<float> f_delay_buffer;
-    int f_samples_delayed;
+    StageProfiler profiler;
+    AnalysisTap analysis_tap;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LearningLiveProcessingAudioProcessor)
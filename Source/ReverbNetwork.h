@@ -0,0 +1,783 @@
+/*
+  ==============================================================================
+
+    ReverbNetwork.h
+    The diffusion and feedback network, compiled once per quality tier.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <numeric>
+#include <random>
+#include <utility>
+#include "DelayArena.h"
+#include "DelayLine.h"
+#include "FrameOps.h"
+#include "Lfo.h"
+#include "SharedTables.h"
+#include "SimdLevel.h"
+
+// Prebuilt network shapes, cheapest first. Each one is a ReverbNetwork specialisation.
+enum class ReverbTier
+{
+    eco,        // 4 channels, 2 diffusion stages
+    standard,   // 8 channels, 3 diffusion stages
+    dense       // 16 channels, 4 diffusion stages
+};
+
+constexpr int num_reverb_tiers = 3;
+constexpr int max_network_channels = 16;
+static_assert (max_network_channels <= max_frame_lanes, "Every network width needs frame kernels");
+constexpr int max_diffusion_stages = 4;
+
+inline const char* getTierName (ReverbTier tier)
+{
+    switch (tier)
+    {
+        case ReverbTier::eco:      return "eco";
+        case ReverbTier::standard: return "standard";
+        case ReverbTier::dense:    return "dense";
+    }
+
+    return "";
+}
+
+// The tier called name, or fallback if there is none
+inline ReverbTier getTierFromName (const juce::String& name, ReverbTier fallback)
+{
+    for (auto tier : { ReverbTier::eco, ReverbTier::standard, ReverbTier::dense })
+        if (name.trim().equalsIgnoreCase (getTierName (tier)))
+            return tier;
+
+    return fallback;
+}
+
+// What the network takes from the smoothed parameters
+struct NetworkSettings
+{
+    float size = 1.0f;         // scales every delay, which glide to a new size
+    float decay = 1.0f;        // RT60 of the lows, in seconds
+    float damping = 0.0f;      // 0 to 1, how much faster the highs decay
+    float diffusion = 1.0f;    // Hadamard blend of each stage, 0 to 1
+    float modulation = 0.0f;   // LFO depth, 0 to 1
+};
+
+//==============================================================================
+/**
+    The random part of a network: the polarity flips and channel order of
+    every diffusion stage, generated from a seed.
+
+    The same seed gives the same tables on every platform and in every
+    session, so the seed is all a saved session needs to recall them. Only
+    std::mt19937 is used, whose output the standard fixes, and the shuffle
+    is written out because std::shuffle differs between standard libraries.
+*/
+template <int Channels, int Stages>
+struct NetworkTopology
+{
+    explicit NetworkTopology (juce::uint32 seed)
+    {
+        std::mt19937 generator (seed);
+
+        for (int stage = 0; stage < Stages; ++stage)
+        {
+            for (int channel = 0; channel < Channels; ++channel)
+                polarities[(size_t) stage].lane[channel] = (generator() & 1) != 0 ? -1.0f : 1.0f;
+
+            // Fisher-Yates
+            auto& order = swaps[(size_t) stage];
+            std::iota (order.begin(), order.end(), 0);
+
+            for (int i = Channels - 1; i > 0; --i)
+                std::swap (order[(size_t) i], order[(size_t) (generator() % (juce::uint32) (i + 1))]);
+        }
+    }
+
+    std::array<FrameConstants, Stages> polarities {};
+    std::array<std::array<int, Channels>, Stages> swaps {};
+};
+
+//==============================================================================
+/**
+    The reverb network behind a virtual interface, so the processor can pick
+    a tier at runtime.
+
+    Every call works on whole quanta of interleaved frames (one sample of
+    every channel per frame) and nothing allocates after prepare(). Dispatch
+    costs one virtual call per stage per quantum; everything below it is
+    compiled for the tier's channel count, stage count and quantum.
+*/
+class ReverbEngine
+{
+public:
+    virtual ~ReverbEngine() = default;
+
+    static constexpr float max_size = 2.0f;
+
+    virtual int getNumChannels() const = 0;
+    virtual int getNumStages() const = 0;
+
+    // Message thread. Sizes every line for the largest room and the deepest
+    // modulation at networkRate; applySettings() and clear() then make it
+    // ready to run. Preparing again at the same rate keeps the allocations.
+    virtual void prepare (double networkRate) = 0;
+    virtual void release() = 0;
+
+    // Silences the network and restarts the LFOs from the current settings, keeping every allocation
+    virtual void clear() = 0;
+
+    // clear() a piece at a time, for the audio thread: zeroes the delay lines
+    // from byteOffset for up to maxBytes and returns where the next call
+    // carries on. Once that is getDelayBytes() the network runs as if cleared.
+    virtual size_t clearPart (size_t byteOffset, size_t maxBytes) = 0;
+
+    // Only between quanta (between ticks in pipelined mode, where the stages
+    // read these). Reads glide to new delays rather than jumping to them.
+    virtual void applySettings (const NetworkSettings& settings) = 0;
+
+    // Starts every read from its delay at the current settings and the LFOs
+    // from their start phases, as clear() does, without touching the lines.
+    // For a network that is silent anyway, like an idle tier switched to,
+    // whose reads would otherwise glide from wherever they last were.
+    virtual void resetReads() = 0;
+
+    // Message thread. The topology for seed, which instances using the same
+    // seed and tier share, built if none of them holds it yet. Its type
+    // depends on the tier, so it is handed round as an opaque pointer.
+    virtual std::shared_ptr<const void> findTopology (juce::uint32 seed) const = 0;
+
+    // With no quantum running. Switches to a topology from findTopology() on
+    // this engine and hands back the one it replaces. Neither allocates nor
+    // frees, so this can run under the callback lock and the caller lets go
+    // of the old tables once it is released.
+    virtual std::shared_ptr<const void> setTopology (std::shared_ptr<const void> tables) = 0;
+
+    // Planar stereo -> frames through the input matrix
+    virtual void split (const float* left, const float* right, float* frames) = 0;
+
+    // One diffusion stage: per channel delays with the channel shuffle folded
+    // into the reads, then polarity flips and the blended Hadamard mix
+    virtual void diffuse (int stage, const float* input, float* output) = 0;
+
+    // The feedback delay network. scratch holds one quantum of frames.
+    virtual void feedback (const float* input, float* output, float* scratch) = 0;
+
+    // Adds both wet paths to left and right through the output matrix
+    virtual void decode (const float* diffused, const float* looped, float* left, float* right, int numFrames) = 0;
+
+    // Longest path through the diffusers and longest loop, modulation
+    // included, in network samples at the current settings, or longer while
+    // reads are still gliding down from longer delays
+    virtual int getFeedforwardSamples() const = 0;
+    virtual int getLoopSamples() const = 0;
+
+    // Through the diffusers and once round the longest loop, in seconds at size
+    virtual double getPathSeconds (float size) const = 0;
+
+    // Memory the delay lines take after prepare()
+    virtual size_t getDelayBytes() const = 0;
+};
+
+//==============================================================================
+/**
+    The network for one tier: Stages diffusion stages of Channels delay lines
+    each, then a Channels line feedback delay network, all running on blocks
+    of Quantum frames. The lines store Sample, float or HalfFloat; everything
+    read from them is float. Level is the instruction set the hot paths are
+    compiled for, and must be one the CPU supports.
+
+    The delay lengths are constexpr ratios of the room size, the polarity and
+    swap tables are fixed-size arrays, and every frame kernel is the
+    FrameOps<Channels, Level> instantiation, so each loop over channels,
+    stages or frames has a trip count the compiler knows.
+*/
+template <int Channels, int Stages, int Quantum, typename Sample, SimdLevel Level>
+class ReverbNetwork final : public ReverbEngine
+{
+public:
+    static_assert (Channels <= max_network_channels, "Raise max_network_channels for wider networks");
+    static_assert (Stages >= 1 && Stages <= max_diffusion_stages, "Stage counts run from 1 to max_diffusion_stages");
+
+    using Ops = FrameOps<Channels, Level>;
+    using Region = SimdRegion<Level>;
+    using Topology = NetworkTopology<Channels, Stages>;
+
+    // Half floats convert with F16C where the level has it
+    using Stored = std::conditional_t<std::is_same_v<Sample, float>, float, typename HalfFloatFor<Level>::Type>;
+    using Line = BasicDelayLine<Stored>;
+    using Arena = DelayArena<Stored>;
+
+    explicit ReverbNetwork (juce::uint32 seed)
+        : topology (SharedTables<Topology>::get (seed))
+    {
+        // Left feeds the even lanes and right the odd ones, so a mono input still
+        // reaches every lane at unit gain. The outputs use two orthogonal sign
+        // patterns (all ones, and alternating), which keeps left and right
+        // decorrelated. The output gain keeps wider networks at the level of 8 channels.
+        const float output_gain = std::sqrt (8.0f / Channels);
+        for (int channel = 0; channel < Channels; ++channel)
+        {
+            const bool even = channel % 2 == 0;
+            input_left.lane[channel] = even ? 1.0f : 0.0f;
+            input_right.lane[channel] = even ? 0.0f : 1.0f;
+            output_left.lane[channel] = output_gain;
+            output_right.lane[channel] = even ? output_gain : -output_gain;
+        }
+    }
+
+    int getNumChannels() const override { return Channels; }
+    int getNumStages() const override { return Stages; }
+
+    void prepare (double networkRate) override
+    {
+        network_rate = networkRate;
+
+        // Sized for the largest room and the deepest modulation, so the size and
+        // modulation parameters only move read positions
+        const int max_reach_samples = static_cast<int> (std::ceil (max_modulation_ms * 0.001 * network_rate)) + 3;
+
+        // Every line gets exactly its own size, laid out in the order a
+        // quantum runs through them, all in the one arena
+        std::array<int, (Stages + 1) * Channels> sizes {};
+        for (int stage = 0; stage < Stages; ++stage)
+            for (int channel = 0; channel < Channels; ++channel)
+                sizes[(size_t) (stage * Channels + channel)]
+                    = Line::getRequiredSize (maxDelaySamples (diffusion_times[(size_t) stage][(size_t) channel]) + max_reach_samples, Quantum);
+
+        for (int channel = 0; channel < Channels; ++channel)
+            sizes[(size_t) (Stages * Channels + channel)]
+                = Line::getRequiredSize (maxDelaySamples (loop_times[(size_t) channel]) + max_reach_samples, Quantum);
+
+        int total = 0;
+        for (auto size : sizes)
+            total += Arena::getFootprint (size);
+
+        arena.prepare (total);
+
+        int offset = 0;
+        size_t index = 0;
+        auto attach = [&] (Line& line)
+        {
+            line.attach (arena.get (offset), sizes[index]);
+            offset += Arena::getFootprint (sizes[index++]);
+        };
+
+        for (auto& stage_lines : lines)
+            for (auto& line : stage_lines)
+                attach (line);
+
+        for (auto& line : loop_lines)
+            attach (line);
+
+        prepareModulation();
+    }
+
+    void release() override
+    {
+        for (auto& stage_lines : lines)
+            for (auto& line : stage_lines)
+                line.release();
+
+        for (auto& line : loop_lines)
+            line.release();
+
+        arena.release();
+    }
+
+    void clear() override
+    {
+        for (auto& stage_lines : lines)
+            for (auto& line : stage_lines)
+                line.clear();
+
+        for (auto& line : loop_lines)
+            line.clear();
+
+        damping_state = {};
+        resetReads();
+    }
+
+    // The lines hold nothing but zeros once the arena is done, wherever their write heads are
+    size_t clearPart (size_t byteOffset, size_t maxBytes) override
+    {
+        const size_t end = juce::jmin (byteOffset + maxBytes, arena.getBytes());
+        arena.clear (byteOffset, end - byteOffset);
+
+        if (end == arena.getBytes())
+        {
+            damping_state = {};
+            resetReads();
+        }
+
+        return end;
+    }
+
+    // Only read positions and gains change here; every line was allocated for
+    // the largest settings. The reads glide to the new positions over the
+    // following quanta.
+    void applySettings (const NetworkSettings& settings) override
+    {
+        const float size = settings.size;
+
+        for (int stage = 0; stage < Stages; ++stage)
+            for (int channel = 0; channel < Channels; ++channel)
+                diffusion_samples[(size_t) stage][(size_t) channel] = delaySamples (diffusion_times[(size_t) stage][(size_t) channel], size);
+
+        for (int channel = 0; channel < Channels; ++channel)
+            loop_samples[(size_t) channel] = delaySamples (loop_times[(size_t) channel], size);
+
+        longest_loop_samples = *std::max_element (loop_samples.begin(), loop_samples.end());
+
+        // Each lane's filter is worked out for its own loop length
+        const float high_decay = settings.decay * (1.0f - max_damping * settings.damping);
+        for (int channel = 0; channel < Channels; ++channel)
+            setLoopDamping (channel, loop_samples[(size_t) channel], settings.decay, high_decay);
+
+        diffusion_amount = settings.diffusion;
+
+        modulation_depth = settings.modulation * max_modulation_ms * 0.001f * static_cast<float> (network_rate);
+        modulation_reach_samples = modulation_depth > 0.0f ? static_cast<int> (std::ceil (modulation_depth)) + 2 : 0;
+
+        // How far past the new delays any read still is. Kept until the next
+        // change, so it only ever overstates the reach.
+        double overshoot = 0.0;
+        for (int stage = 0; stage < Stages; ++stage)
+            for (int channel = 0; channel < Channels; ++channel)
+                overshoot = juce::jmax (overshoot, diffusion_ends[(size_t) stage][(size_t) channel]
+                                                       - static_cast<double> (diffusion_samples[(size_t) stage][(size_t) channel]));
+
+        for (int channel = 0; channel < Channels; ++channel)
+            overshoot = juce::jmax (overshoot, loop_ends[(size_t) channel] - static_cast<double> (loop_samples[(size_t) channel] - Quantum));
+
+        glide_reach_samples = static_cast<int> (std::ceil (overshoot));
+    }
+
+    void resetReads() override
+    {
+        for (int stage = 0; stage < Stages; ++stage)
+            for (int channel = 0; channel < Channels; ++channel)
+            {
+                diffusion_lfos[(size_t) stage][(size_t) channel].reset();
+                diffusion_ends[(size_t) stage][(size_t) channel] = static_cast<double> (diffusion_samples[(size_t) stage][(size_t) channel]);
+            }
+
+        for (int channel = 0; channel < Channels; ++channel)
+        {
+            loop_lfos[(size_t) channel].reset();
+            loop_ends[(size_t) channel] = static_cast<double> (loop_samples[(size_t) channel] - Quantum);
+        }
+
+        glide_reach_samples = 0;
+    }
+
+    std::shared_ptr<const void> findTopology (juce::uint32 seed) const override
+    {
+        return SharedTables<Topology>::get (seed);
+    }
+
+    std::shared_ptr<const void> setTopology (std::shared_ptr<const void> tables) override
+    {
+        jassert (tables != nullptr);
+        return std::exchange (topology, std::static_pointer_cast<const Topology> (std::move (tables)));
+    }
+
+    void split (const float* left, const float* right, float* frames) override
+    {
+        Region::run ([&] { Ops::inject (frames, left, right, Quantum, input_left, input_right); });
+    }
+
+    // The hot paths, each compiled for Level in one SimdRegion: the frame
+    // kernels, the delay line reads and writes, and the half float conversions
+    // are all inlined into it.
+    void diffuse (int stage, const float* input, float* output) override
+    {
+        Region::run ([&] { diffuseStage (stage, input, output); });
+    }
+
+    void feedback (const float* input, float* output, float* scratch) override
+    {
+        Region::run ([&] { feedbackLoop (input, output, scratch); });
+    }
+
+    void decode (const float* diffused, const float* looped, float* left, float* right, int numFrames) override
+    {
+        Region::run ([&]
+        {
+            Ops::decode (left, right, looped, numFrames, output_left, output_right);
+            Ops::decode (left, right, diffused, numFrames, output_left, output_right);
+        });
+    }
+
+    int getFeedforwardSamples() const override
+    {
+        int total = 0;
+        for (const auto& delays : diffusion_samples)
+            total += *std::max_element (delays.begin(), delays.end()) + modulation_reach_samples + glide_reach_samples;
+
+        return total;
+    }
+
+    int getLoopSamples() const override { return longest_loop_samples + modulation_reach_samples + glide_reach_samples; }
+
+    double getPathSeconds (float size) const override
+    {
+        double seconds = loop_times[0];
+        for (const auto& times : diffusion_times)
+            seconds += *std::max_element (times.begin(), times.end());
+
+        return size * seconds;
+    }
+
+    size_t getDelayBytes() const override { return arena.getBytes(); }
+
+private:
+    //==============================================================================
+    // Writes each lane into its delay line and reads the delayed lanes back out.
+    // The channel shuffle is folded into the read: output lane c comes from line swaps[c].
+    void diffuseStage (int stage, const float* input, float* output)
+    {
+        auto& stage_lines = lines[(size_t) stage];
+        const auto& order = topology->swaps[(size_t) stage];
+        const auto& delays = diffusion_samples[(size_t) stage];
+
+        for (int channel = 0; channel < Channels; ++channel)
+            stage_lines[(size_t) channel].write (input + channel, Quantum, Channels);
+
+        if (modulation_depth > 0.0f || isGliding (diffusion_ends[(size_t) stage], delays, 0))
+        {
+            readModulated (output, windows[stage], stage_lines, order.data(), delays, 0,
+                           diffusion_lfos[(size_t) stage], diffusion_ends[(size_t) stage]);
+        }
+        else
+        {
+            for (int channel = 0; channel < Channels; ++channel)
+            {
+                const int source = order[(size_t) channel];
+                stage_lines[(size_t) source].read (output + channel, Quantum, delays[(size_t) source], Channels);
+                diffusion_ends[(size_t) stage][(size_t) source] = static_cast<double> (delays[(size_t) source]);
+            }
+        }
+
+        Ops::hadamard (output, Quantum, topology->polarities[(size_t) stage], diffusion_amount);
+    }
+
+    // The shortest loop is far longer than a quantum, so each lane's delayed
+    // block is read whole, the network is mixed over the block, and each
+    // lane's block is written back, instead of going round sample by sample.
+    void feedbackLoop (const float* input, float* output, float* scratch)
+    {
+        // The delayed blocks are read before this block is written, so every delay has to cover it
+        jassert (Quantum <= *std::min_element (loop_samples.begin(), loop_samples.end()));
+
+        // What comes back round the loop is also the output
+        if (modulation_depth > 0.0f || isGliding (loop_ends, loop_samples, -Quantum))
+        {
+            readModulated (output, windows[Stages], loop_lines, nullptr, loop_samples, -Quantum, loop_lfos, loop_ends);
+        }
+        else
+        {
+            for (int channel = 0; channel < Channels; ++channel)
+            {
+                const int read_delay = loop_samples[(size_t) channel] - Quantum;
+                loop_lines[(size_t) channel].read (output + channel, Quantum, read_delay, Channels);
+                loop_ends[(size_t) channel] = static_cast<double> (read_delay);
+            }
+        }
+
+        // Input joins the delayed blocks, the loop's decay comes off, and the Householder matrix mixes the lanes
+        juce::FloatVectorOperations::copy (scratch, output, Quantum * Channels);
+        juce::FloatVectorOperations::addWithMultiply (scratch, input, loop_input_gain, Quantum * Channels);
+
+        Ops::onePole (scratch, Quantum, damping_gains, damping_poles, damping_state);
+        Ops::householder (scratch, Quantum);
+
+        for (int channel = 0; channel < Channels; ++channel)
+            loop_lines[(size_t) channel].write (scratch + channel, Quantum, Channels);
+    }
+
+    //==============================================================================
+    // DELAY LENGTHS, in seconds at size 1
+
+    // Stage s spreads its channels evenly from 1x to 8x of 10 ms * 2^s
+    static constexpr std::array<float, max_diffusion_stages> delay_steps { 0.01f, 0.02f, 0.04f, 0.08f };
+    static constexpr float max_delay_multiple = 8.0f;
+
+    static constexpr std::array<std::array<float, Channels>, Stages> makeDiffusionTimes()
+    {
+        std::array<std::array<float, Channels>, Stages> times {};
+        for (int stage = 0; stage < Stages; ++stage)
+            for (int channel = 0; channel < Channels; ++channel)
+            {
+                const float multiple = 1.0f + (max_delay_multiple - 1.0f) * channel / (Channels - 1);
+                times[(size_t) stage][(size_t) channel] = multiple * delay_steps[(size_t) stage];
+            }
+
+        return times;
+    }
+
+    // The longest loop is f_delay_time and the others step down geometrically
+    // to half of it, so no two lanes ring with the same period
+    static constexpr float f_delay_time = 0.2f;
+
+    // 2^-x for 0 <= x < 1, from the exponential series, which std::pow can't do at compile time
+    static constexpr double halfPower (double x)
+    {
+        const double y = -x * 0.6931471805599453;
+        double term = 1.0, sum = 1.0;
+        for (int n = 1; n < 20; ++n)
+        {
+            term *= y / n;
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    static constexpr std::array<float, Channels> makeLoopTimes()
+    {
+        std::array<float, Channels> times {};
+        for (int channel = 0; channel < Channels; ++channel)
+            times[(size_t) channel] = static_cast<float> (f_delay_time * halfPower ((double) channel / Channels));
+
+        return times;
+    }
+
+    static constexpr auto diffusion_times = makeDiffusionTimes();
+    static constexpr auto loop_times = makeLoopTimes();
+
+    int delaySamples (float seconds, float size) const
+    {
+        return static_cast<int> (std::round (seconds * size * network_rate));
+    }
+
+    int maxDelaySamples (float seconds) const { return delaySamples (seconds, max_size); }
+
+    //==============================================================================
+    // DAMPING
+
+    static constexpr float max_damping = 0.9f;
+
+    // Gain and pole of a one-pole shelf for a lane whose loop is loopSamples
+    // long, so that a pass loses 60 dB * loop time / RT60 at DC for lowRT60
+    // and at Nyquist for highRT60. With g0 and gpi those two per pass gains:
+    //     pole = (g0 - gpi) / (g0 + gpi),  gain = g0 * (1 - pole)
+    // Equal RT60s give pole 0 and exactly the broadband gain.
+    void setLoopDamping (int lane, int loopSamples, float lowRT60, float highRT60)
+    {
+        const float loop_time = static_cast<float> (loopSamples / network_rate);
+        const float low_gain = juce::Decibels::decibelsToGain (-60.0f * loop_time / lowRT60);
+        const float high_gain = juce::Decibels::decibelsToGain (-60.0f * loop_time / highRT60);
+
+        damping_poles.lane[lane] = (low_gain - high_gain) / (low_gain + high_gain);
+        damping_gains.lane[lane] = low_gain * (1.0f - damping_poles.lane[lane]);
+    }
+
+    //==============================================================================
+    // MODULATION
+
+    // Every line has its own slow sine LFO, each a little different in rate
+    // and phase, moving its read position by up to max_modulation_ms. The
+    // LFOs step once per quantum and the delay ramps linearly in between, so
+    // a quantum's reads are one contiguous window per line and per sample
+    // only the interpolation costs anything. At zero depth the plain integer
+    // reads are used, except while a size change glides them.
+    static constexpr float max_modulation_ms = 1.0f;
+    static constexpr double min_lfo_hz = 0.3;
+    static constexpr double max_lfo_hz = 0.9;
+
+    // LFO rates and phases, spread so no two lines move together. The golden
+    // ratio sequence scatters the rates over their range without any pattern.
+    // Lines are numbered as if every tier had max_diffusion_stages, so a line
+    // moves the same way whichever tier it is in.
+    void prepareModulation()
+    {
+        constexpr int num_lines = (max_diffusion_stages + 1) * Channels;
+        const double golden_ratio_conjugate = 0.6180339887498949;
+
+        auto prepare_lfo = [&] (QuadratureLfo& lfo, int line)
+        {
+            const double position = std::fmod ((line + 0.5) * golden_ratio_conjugate, 1.0);
+            const double frequency = min_lfo_hz + (max_lfo_hz - min_lfo_hz) * position;
+            lfo.prepare (frequency, network_rate, Quantum, juce::MathConstants<double>::twoPi * line / num_lines);
+        };
+
+        for (int stage = 0; stage < Stages; ++stage)
+            for (int channel = 0; channel < Channels; ++channel)
+                prepare_lfo (diffusion_lfos[(size_t) stage][(size_t) channel], stage * Channels + channel);
+
+        for (int channel = 0; channel < Channels; ++channel)
+            prepare_lfo (loop_lfos[(size_t) channel], max_diffusion_stages * Channels + channel);
+    }
+
+    // Modulated and gliding reads from a set of lines. Output lane c comes
+    // from line sources[c] (line c when sources is null), delayed by that
+    // line's delay plus delayOffset plus its LFO, and ends tracks where each
+    // line's read finished. Every line copies the window its reads span into
+    // one lane of the window frames, then all lanes are interpolated in one
+    // SIMD pass.
+    //
+    // A window only spans one sample of movement. The LFOs move a read far
+    // less than that per quantum, but a size change glides it by up to
+    // Quantum / glide_span samples, so while any read moves further the
+    // quantum is read as glide_pieces windows of glide_span frames each.
+    //
+    // Read positions are kept in double, so that how the instruction set
+    // rounds the LFO never moves a long delay's read by a whole float ulp.
+    void readModulated (float* output, float* window, const std::array<Line, Channels>& sourceLines, const int* sources,
+                        const std::array<int, Channels>& delays, int delayOffset,
+                        std::array<QuadratureLfo, Channels>& lfos, std::array<double, Channels>& ends)
+    {
+        std::array<double, Channels> starts;
+        double furthest = 0.0;
+
+        for (int source = 0; source < Channels; ++source)
+        {
+            double target = static_cast<double> (delays[(size_t) source] + delayOffset);
+            if (modulation_depth > 0.0f)
+                target += static_cast<double> (modulation_depth * lfos[(size_t) source].advance());
+
+            starts[(size_t) source] = ends[(size_t) source];
+            ends[(size_t) source] = Line::glideTowards (ends[(size_t) source], target, Quantum);
+            furthest = juce::jmax (furthest, std::abs (ends[(size_t) source] - starts[(size_t) source]));
+        }
+
+        const int pieces = furthest > 1.0 ? glide_pieces : 1;
+        const int piece_frames = Quantum / pieces;
+
+        for (int piece = 0; piece < pieces; ++piece)
+        {
+            FrameConstants fractions, steps;
+
+            // readWindow reads the last frames written, so earlier pieces sit that much further back
+            const double later_frames = static_cast<double> (Quantum - (piece + 1) * piece_frames);
+
+            for (int channel = 0; channel < Channels; ++channel)
+            {
+                const auto source = (size_t) (sources != nullptr ? sources[channel] : channel);
+                const double span = ends[source] - starts[source];
+                const double start = starts[source] + span * piece / pieces + later_frames;
+                const double end = starts[source] + span * (piece + 1) / pieces + later_frames;
+
+                const auto lane = sourceLines[source].readWindow (window + channel, piece_frames, start, end, Channels);
+                fractions.lane[channel] = lane.fraction;
+                steps.lane[channel] = lane.step;
+            }
+
+            Ops::interpolate (output + piece * piece_frames * Channels, window, fractions, steps, piece_frames);
+        }
+    }
+
+    static constexpr int glide_pieces = Quantum / Line::glide_span;
+    static_assert (Quantum % Line::glide_span == 0, "A gliding quantum is read in whole pieces");
+
+    // Whether any read is still on its way to a new delay
+    static bool isGliding (const std::array<double, Channels>& ends, const std::array<int, Channels>& delays, int delayOffset)
+    {
+        for (int channel = 0; channel < Channels; ++channel)
+            if (ends[(size_t) channel] != static_cast<double> (delays[(size_t) channel] + delayOffset))
+                return true;
+
+        return false;
+    }
+
+    //==============================================================================
+    double network_rate = 44100.0;
+
+    // TOPOLOGY, read only and shared with every network on the same seed.
+    // The delay ratios above are constexpr, so they are shared by all of them already.
+    std::shared_ptr<const Topology> topology;
+
+    // Per lane gains from each input channel, and per lane weights into each output channel
+    FrameConstants input_left {}, input_right {};
+    FrameConstants output_left {}, output_right {};
+
+    // LINES, one ring buffer per channel per stage and per loop lane, each
+    // sized for its own delay and all of them in the arena
+    Arena arena;
+    std::array<std::array<Line, Channels>, Stages> lines;
+    std::array<Line, Channels> loop_lines;
+
+    // SETTINGS, derived by applySettings
+    std::array<std::array<int, Channels>, Stages> diffusion_samples {};
+    std::array<int, Channels> loop_samples {};
+    int longest_loop_samples = 0;
+    float diffusion_amount = 1.0f;
+
+    // Every lane feeds the loop, so scaling what goes in by 1 / sqrt (N)
+    // keeps the tail at the level a single fed back lane had
+    const float loop_input_gain = 1.0f / std::sqrt (static_cast<float> (Channels));
+
+    // The loop gain as a one-pole shelf per lane: lows decay over the Decay
+    // time and highs over a shorter time set by Damping. Gains, poles and
+    // state are one frame each, so every lane is filtered in one operation.
+    FrameConstants damping_gains {}, damping_poles {}, damping_state {};
+
+    float modulation_depth = 0.0f;   // in network samples
+    // Furthest a modulated read can reach past its nominal delay, interpolation taps included
+    int modulation_reach_samples = 0;
+    // Furthest a read gliding down from a longer delay was past its new one at the last applySettings
+    int glide_reach_samples = 0;
+
+    std::array<std::array<QuadratureLfo, Channels>, Stages> diffusion_lfos;
+    std::array<QuadratureLfo, Channels> loop_lfos;
+
+    // Where each modulated read ended last quantum, so the next one carries on from there
+    std::array<std::array<double, Channels>, Stages> diffusion_ends {};
+    std::array<double, Channels> loop_ends {};
+
+    // The window each stage's and the loop's modulated reads interpolate from,
+    // separate so pipelined stages never share one
+    alignas (16) float windows[Stages + 1][Channels * (Quantum + 3)] {};
+
+    JUCE_DECLARE_NON_COPYABLE (ReverbNetwork)
+};
+
+//==============================================================================
+template <int Quantum, typename Sample, SimdLevel Level>
+std::unique_ptr<ReverbEngine> createReverbEngineFor (ReverbTier tier, juce::uint32 seed)
+{
+    switch (tier)
+    {
+        case ReverbTier::eco:      return std::make_unique<ReverbNetwork<4, 2, Quantum, Sample, Level>> (seed);
+        case ReverbTier::standard: return std::make_unique<ReverbNetwork<8, 3, Quantum, Sample, Level>> (seed);
+        case ReverbTier::dense:    return std::make_unique<ReverbNetwork<16, 4, Quantum, Sample, Level>> (seed);
+    }
+
+    jassertfalse;
+    return {};
+}
+
+template <int Quantum, typename Sample>
+std::unique_ptr<ReverbEngine> createReverbEngineFor (ReverbTier tier, juce::uint32 seed, SimdLevel level)
+{
+    switch (level)
+    {
+       #if JUCE_USE_SIMD
+       #if JUCE_INTEL
+        case SimdLevel::avx512: return createReverbEngineFor<Quantum, Sample, SimdLevel::avx512> (tier, seed);
+        case SimdLevel::avx2:   return createReverbEngineFor<Quantum, Sample, SimdLevel::avx2> (tier, seed);
+       #endif
+        case SimdLevel::sse2:   return createReverbEngineFor<Quantum, Sample, SimdLevel::sse2> (tier, seed);
+       #endif
+        default:                return createReverbEngineFor<Quantum, Sample, SimdLevel::scalar> (tier, seed);
+    }
+}
+
+/** The network for a tier, with its delay lines in float or, with
+    halfPrecisionDelays, in HalfFloat, and its kernels built for level.
+    Levels above getSupportedSimdLevel() fall back to that one. Allocates,
+    so call it from the message thread.
+*/
+template <int Quantum>
+std::unique_ptr<ReverbEngine> createReverbEngine (ReverbTier tier, juce::uint32 seed, bool halfPrecisionDelays,
+                                                  SimdLevel level = getSupportedSimdLevel())
+{
+    jassert (level <= getSupportedSimdLevel());
+    level = juce::jmin (level, getSupportedSimdLevel());
+
+    return halfPrecisionDelays ? createReverbEngineFor<Quantum, HalfFloat> (tier, seed, level)
+                               : createReverbEngineFor<Quantum, float> (tier, seed, level);
+}
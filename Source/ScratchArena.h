@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    ScratchArena.h
+    Preallocated working storage for the reverb pipeline.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    One contiguous block of float storage carved into a fixed number of slots.
+
+    All memory is allocated in prepare() on the message thread. get() is just
+    pointer arithmetic, so it is safe to call from processBlock. Every slot
+    starts on a cache line, which also satisfies the SIMD alignment that the
+    interleaved frame kernels need.
+*/
+class ScratchArena
+{
+public:
+    ScratchArena() = default;
+
+    // Preparing again with the same layout keeps the allocation and just zeroes it.
+    void prepare (int numSlots, int floatsPerSlot)
+    {
+        const int stride = (floatsPerSlot + floats_per_line - 1) / floats_per_line * floats_per_line;
+
+        if (base != nullptr && numSlots == num_slots && stride == slot_stride)
+        {
+            slot_size = floatsPerSlot;
+            clear();
+            return;
+        }
+
+        num_slots = numSlots;
+        slot_size = floatsPerSlot;
+        slot_stride = stride;
+
+        storage.allocate ((size_t) (num_slots * slot_stride + floats_per_line), true);
+
+        auto address = reinterpret_cast<std::uintptr_t> (storage.get());
+        base = reinterpret_cast<float*> ((address + cache_line_bytes - 1) & ~(std::uintptr_t) (cache_line_bytes - 1));
+    }
+
+    void release()
+    {
+        storage.free();
+        base = nullptr;
+        num_slots = slot_size = slot_stride = 0;
+    }
+
+    void clear()
+    {
+        if (base != nullptr)
+            juce::FloatVectorOperations::clear (base, num_slots * slot_stride);
+    }
+
+    float* get (int slot) const
+    {
+        jassert (slot < num_slots);
+        return base + slot * slot_stride;
+    }
+
+    int getSlotSize() const { return slot_size; }
+
+private:
+    static constexpr int cache_line_bytes = 64;
+    static constexpr int floats_per_line = cache_line_bytes / (int) sizeof (float);
+
+    juce::HeapBlock<float> storage;
+    float* base = nullptr;
+
+    int num_slots = 0;
+    int slot_size = 0;
+    int slot_stride = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (ScratchArena)
+};
@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    SharedTables.h
+    Process-wide cache of read-only tables, shared between plugin instances.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+
+//==============================================================================
+/**
+    Interns read-only tables by key, so every instance that asks for the same
+    key holds the same copy.
+
+    Tables is built from its key alone (it needs a constructor taking one)
+    and is never written after that, so any number of threads can read a
+    shared copy. The cache itself only holds weak references: a table lives
+    for as long as some instance holds it, and the next lookup forgets it
+    once none does.
+
+    get() takes a lock and may allocate, so call it from the message thread.
+*/
+template <typename Tables>
+class SharedTables
+{
+public:
+    using Key = juce::uint32;
+
+    static std::shared_ptr<const Tables> get (Key key)
+    {
+        auto& cache = getCache();
+        const juce::ScopedLock lock (cache.lock);
+
+        for (auto it = cache.entries.begin(); it != cache.entries.end();)
+            it = it->second.expired() ? cache.entries.erase (it) : std::next (it);
+
+        auto& entry = cache.entries[key];
+        if (auto existing = entry.lock())
+            return existing;
+
+        auto tables = std::make_shared<const Tables> (key);
+        entry = tables;
+        return tables;
+    }
+
+private:
+    struct Cache
+    {
+        juce::CriticalSection lock;
+        std::map<Key, std::weak_ptr<const Tables>> entries;
+    };
+
+    // One per Tables type in the process, made on first use
+    static Cache& getCache()
+    {
+        static Cache cache;
+        return cache;
+    }
+};
@@ -0,0 +1,184 @@
+/*
+  ==============================================================================
+
+    SimdLevel.h
+    The instruction sets the network kernels are built for, and picking one at runtime.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <cpuid.h>
+  #include <x86intrin.h>
+ #endif
+#endif
+
+// Every build of the network kernels, slowest first. One binary holds all
+// the ones its target can have, and picks the best the CPU runs.
+enum class SimdLevel
+{
+    scalar,     // plain C++, one lane at a time: the reference the others are checked against
+    sse2,       // 128 bit registers: SSE2 on x86, NEON on ARM
+    avx2,       // 256 bit registers, with FMA and F16C (x86 only)
+    avx512      // 512 bit registers, AVX-512F (x86 only)
+};
+
+inline const char* getSimdLevelName (SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::scalar: return "scalar";
+        case SimdLevel::sse2:   return "sse2";
+        case SimdLevel::avx2:   return "avx2";
+        case SimdLevel::avx512: return "avx512";
+    }
+
+    return "";
+}
+
+// The level called name, or fallback if there is none
+inline SimdLevel getSimdLevelFromName (const juce::String& name, SimdLevel fallback)
+{
+    for (auto level : { SimdLevel::scalar, SimdLevel::sse2, SimdLevel::avx2, SimdLevel::avx512 })
+        if (name.trim().equalsIgnoreCase (getSimdLevelName (level)))
+            return level;
+
+    return fallback;
+}
+
+// Floats in one register at a level
+constexpr int getSimdWidth (SimdLevel level)
+{
+    return level == SimdLevel::avx512 ? 16
+         : level == SimdLevel::avx2   ? 8
+         : level == SimdLevel::sse2   ? 4
+                                      : 1;
+}
+
+//==============================================================================
+/**
+    The best level this build has kernels for and this CPU and operating
+    system can run, read from CPUID once, the first time it is asked for.
+
+    Each level needs the instructions and also the operating system saving
+    the wider registers across context switches (XGETBV), or the first AVX
+    instruction faults even on a CPU that has it.
+*/
+inline SimdLevel getSupportedSimdLevel()
+{
+    static const SimdLevel supported = []
+    {
+       #if ! JUCE_USE_SIMD
+        return SimdLevel::scalar;
+       #elif JUCE_INTEL && JUCE_64BIT
+        auto cpuid = [] (unsigned int leaf, unsigned int (&regs)[4])
+        {
+           #if JUCE_MSVC
+            int info[4];
+            __cpuidex (info, (int) leaf, 0);
+            for (int i = 0; i < 4; ++i)
+                regs[i] = (unsigned int) info[i];
+           #else
+            __cpuid_count (leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+           #endif
+        };
+
+        unsigned int regs[4] {};
+        cpuid (0, regs);
+        const auto max_leaf = regs[0];
+
+        cpuid (1, regs);
+        const auto leaf1_ecx = regs[2];
+        const bool has_os_xsave = (leaf1_ecx & (1u << 27)) != 0;
+        const bool has_avx = (leaf1_ecx & (1u << 28)) != 0;
+        const bool has_fma = (leaf1_ecx & (1u << 12)) != 0;
+        const bool has_f16c = (leaf1_ecx & (1u << 29)) != 0;
+
+        unsigned int leaf7_ebx = 0;
+        if (max_leaf >= 7)
+        {
+            cpuid (7, regs);
+            leaf7_ebx = regs[1];
+        }
+
+        const bool has_avx2 = (leaf7_ebx & (1u << 5)) != 0;
+        const bool has_avx512f = (leaf7_ebx & (1u << 16)) != 0;
+
+        // Register state the OS saves: bits 1-2 for SSE and AVX, 5-7 for the AVX-512 masks and upper halves
+        auto read_os_state = []
+        {
+           #if JUCE_MSVC
+            return (juce::uint64) _xgetbv (0);
+           #else
+            unsigned int low, high;
+            __asm__ ("xgetbv" : "=a" (low), "=d" (high) : "c" (0));
+            return (juce::uint64) high << 32 | low;
+           #endif
+        };
+
+        const auto os_state = has_os_xsave ? read_os_state() : 0;
+        const bool os_saves_avx = (os_state & 0x06) == 0x06;
+        const bool os_saves_avx512 = (os_state & 0xe6) == 0xe6;
+
+        if (has_avx && has_avx2 && has_fma && has_f16c && os_saves_avx)
+            return has_avx512f && os_saves_avx512 ? SimdLevel::avx512 : SimdLevel::avx2;
+
+        return SimdLevel::sse2;   // part of every x86-64 CPU
+       #else
+        return SimdLevel::sse2;   // SSE2 on 32 bit x86 builds, NEON on ARM
+       #endif
+    }();
+
+    return supported;
+}
+
+//==============================================================================
+// Functions that may use a level's instructions. On GCC and Clang each
+// carries that level's target, so the code in it can be compiled for AVX
+// without building the whole plugin for it, and is flattened so every call
+// in it is inlined and compiled for that target too. MSVC takes the
+// intrinsics anywhere and needs neither.
+#if JUCE_INTEL && (JUCE_GCC || JUCE_CLANG)
+ #define REVERB_AVX2_FUNCTION     __attribute__ ((target ("avx2,fma,f16c")))
+ #define REVERB_AVX512_FUNCTION   __attribute__ ((target ("avx512f,avx2,fma,f16c")))
+ #define REVERB_FLATTEN           __attribute__ ((flatten))
+#else
+ #define REVERB_AVX2_FUNCTION
+ #define REVERB_AVX512_FUNCTION
+ #define REVERB_FLATTEN
+#endif
+
+/**
+    Runs a piece of code compiled for a level: run (f) calls f, with f and
+    everything it calls inlined into a function built for Level's
+    instructions. Only run it on a CPU that supports Level.
+*/
+template <SimdLevel Level>
+struct SimdRegion
+{
+    template <typename Function>
+    static void run (Function&& function) { function(); }
+};
+
+#if JUCE_INTEL
+template <>
+struct SimdRegion<SimdLevel::avx2>
+{
+    template <typename Function>
+    REVERB_AVX2_FUNCTION REVERB_FLATTEN static void run (Function&& function) { function(); }
+};
+
+template <>
+struct SimdRegion<SimdLevel::avx512>
+{
+    template <typename Function>
+    REVERB_AVX512_FUNCTION REVERB_FLATTEN static void run (Function&& function) { function(); }
+};
+#endif
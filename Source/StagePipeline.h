@@ -0,0 +1,255 @@
+/*
+  ==============================================================================
+
+    StagePipeline.h
+    Worker threads that run the reverb stages as a software pipeline.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #include <windows.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#else
+ #include <semaphore.h>
+ #include <ctime>
+#endif
+
+//==============================================================================
+/**
+    Runs a fixed number of stages, one worker thread each, in lock step.
+
+    Every tick hands each worker one more job. Stage s works on hop
+    (tick - s), so all stages run at the same time on different hops and the
+    audio moves forward one stage per tick. The client keeps neighbouring hops
+    apart with double buffered slots picked by hop parity.
+
+    Each worker has atomic tick counters: job_tick is only written by the
+    audio thread and done_tick by whoever ran the job, so no audio data is
+    ever locked. Idle workers sleep on a semaphore, and the audio thread only
+    posts it when the worker has said it is asleep, which never blocks.
+
+    If a worker has not even started its job by the time the audio thread
+    needs it, the audio thread claims the job and runs it itself, so a
+    descheduled worker costs one serial stage instead of a dropout.
+*/
+class StagePipeline
+{
+public:
+    struct Client
+    {
+        virtual ~Client() = default;
+
+        // Called for hop (tick - stage), normally on the worker thread that
+        // owns stage but on the audio thread when that worker is late. Never
+        // called twice at once for the same stage.
+        virtual void runPipelineStage (int stage, juce::int64 tick) = 0;
+    };
+
+    StagePipeline() = default;
+    ~StagePipeline() { stop(); }
+
+    // Message thread. Starts one realtime worker per stage, each expected to
+    // wake once every periodMs.
+    void start (Client& client, int numStages, double periodMs)
+    {
+        stop();
+
+        const auto options = juce::Thread::RealtimeOptions{}.withPriority (9).withPeriodMs (periodMs);
+
+        for (int stage = 0; stage < numStages; ++stage)
+        {
+            workers.push_back (std::make_unique<Worker> (client, stage));
+
+            // Without the rights for a realtime thread, e.g. on Linux without
+            // rtprio, the highest normal priority is the best left
+            if (! workers.back()->startRealtimeThread (options))
+                workers.back()->startThread (juce::Thread::Priority::highest);
+        }
+
+        posted_tick = 0;
+    }
+
+    // Message thread. Waits for the workers to finish their current job and exit.
+    void stop()
+    {
+        for (auto& worker : workers)
+        {
+            worker->signalThreadShouldExit();
+            worker->wake.post();
+        }
+
+        for (auto& worker : workers)
+            worker->stopThread (1000);
+
+        workers.clear();
+    }
+
+    bool isRunning() const { return ! workers.empty(); }
+    int getNumStages() const { return (int) workers.size(); }
+
+    // Audio thread. Returns once every stage has finished the last tick, with
+    // the number of the next one. The workers had a whole hop of audio time
+    // for that tick, so this normally returns without waiting. Past a short
+    // spin, stages nobody has started are run here instead.
+    juce::int64 waitForStages()
+    {
+        const auto deadline = juce::Time::getMillisecondCounterHiRes() + late_stage_ms;
+        bool late = false;
+
+        for (auto& worker : workers)
+        {
+            while (worker->done_tick.load (std::memory_order_acquire) < posted_tick)
+            {
+                if (! late)
+                    late = juce::Time::getMillisecondCounterHiRes() >= deadline;
+
+                // A worker already running its job finishes it soon enough
+                if (late && worker->claim (posted_tick))
+                {
+                    worker->client.runPipelineStage (worker->stage, posted_tick);
+                    worker->done_tick.store (posted_tick, std::memory_order_release);
+                    break;
+                }
+
+                juce::Thread::yield();
+            }
+        }
+
+        return posted_tick + 1;
+    }
+
+    // Audio thread. Starts tick on every stage. Anything the stages read must
+    // be written before this is called.
+    void startTick (juce::int64 tick)
+    {
+        jassert (tick == posted_tick + 1);
+        posted_tick = tick;
+
+        for (auto& worker : workers)
+        {
+            worker->job_tick.store (tick);
+
+            if (worker->sleeping.exchange (false))
+                worker->wake.post();
+        }
+    }
+
+private:
+    // How long the audio thread spins on a stage before taking it over
+    static constexpr double late_stage_ms = 0.1;
+
+    //==============================================================================
+    // Counting semaphore whose post never blocks, so the audio thread can use it
+    class Semaphore
+    {
+    public:
+       #if JUCE_WINDOWS
+        Semaphore()  : handle (CreateSemaphoreW (nullptr, 0, 1 << 30, nullptr)) {}
+        ~Semaphore() { CloseHandle (handle); }
+        void post()  { ReleaseSemaphore (handle, 1, nullptr); }
+        void wait (int ms) { WaitForSingleObject (handle, (DWORD) ms); }
+       #elif JUCE_MAC || JUCE_IOS
+        Semaphore()  : handle (dispatch_semaphore_create (0)) {}
+        ~Semaphore() { dispatch_release (handle); }
+        void post()  { dispatch_semaphore_signal (handle); }
+        void wait (int ms) { dispatch_semaphore_wait (handle, dispatch_time (DISPATCH_TIME_NOW, (int64_t) ms * NSEC_PER_MSEC)); }
+       #else
+        Semaphore()  { sem_init (&handle, 0, 0); }
+        ~Semaphore() { sem_destroy (&handle); }
+        void post()  { sem_post (&handle); }
+
+        void wait (int ms)
+        {
+            timespec until;
+            clock_gettime (CLOCK_REALTIME, &until);
+            until.tv_nsec += (long) ms * 1000000;
+            until.tv_sec += until.tv_nsec / 1000000000;
+            until.tv_nsec %= 1000000000;
+            sem_timedwait (&handle, &until);
+        }
+       #endif
+
+    private:
+       #if JUCE_WINDOWS
+        HANDLE handle;
+       #elif JUCE_MAC || JUCE_IOS
+        dispatch_semaphore_t handle;
+       #else
+        sem_t handle;
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE (Semaphore)
+    };
+
+    struct Worker : public juce::Thread
+    {
+        Worker (Client& c, int s)
+            : juce::Thread ("Reverb stage " + juce::String (s)), client (c), stage (s)
+        {
+        }
+
+        void run() override
+        {
+            juce::int64 done = 0;
+
+            while (! threadShouldExit())
+            {
+                const auto tick = job_tick.load (std::memory_order_acquire);
+
+                if (tick == done)
+                {
+                    // Checked again after saying so, or a tick posted in
+                    // between would find nobody asleep and never wake us
+                    sleeping.store (true);
+
+                    if (job_tick.load() == done)
+                        wake.wait (100);
+
+                    sleeping.store (false);
+                    continue;
+                }
+
+                // The audio thread may have taken this one over already
+                if (claim (tick))
+                {
+                    client.runPipelineStage (stage, tick);
+                    done_tick.store (tick, std::memory_order_release);
+                }
+
+                done = tick;
+            }
+        }
+
+        // True for exactly one of the worker and the audio thread per tick
+        bool claim (juce::int64 tick)
+        {
+            return claimed_tick.exchange (tick, std::memory_order_acq_rel) != tick;
+        }
+
+        Client& client;
+        const int stage;
+
+        std::atomic<juce::int64> job_tick { 0 };
+        std::atomic<juce::int64> claimed_tick { 0 };
+        std::atomic<juce::int64> done_tick { 0 };
+        std::atomic<bool> sleeping { false };
+        Semaphore wake;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    juce::int64 posted_tick = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (StagePipeline)
+};
@@ -0,0 +1,289 @@
+/*
+  ==============================================================================
+
+    StageProfiler.h
+    Lock-free per-stage timing for the audio and pipeline threads.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+// Build with REVERB_PROFILING=0 to compile every probe out
+#ifndef REVERB_PROFILING
+ #define REVERB_PROFILING 1
+#endif
+
+//==============================================================================
+/**
+    Per-stage histograms of cycles per sample, plus a count of blocks that
+    took longer than their own duration.
+
+    Each stage is only ever timed by one thread at a time (the audio thread,
+    or the pipeline worker that owns it), so recording is a handful of
+    relaxed atomic loads and stores with no read-modify-write and no locks.
+    The message thread reads the same atomics whenever it likes; a snapshot
+    may be a few samples out of step between stages, which is fine for a
+    meter.
+
+    Bins are logarithmic, four per octave, so percentiles are good to about
+    10%. The maximum is exact.
+
+    Cycles come from the time stamp counter on x86 and from the virtual timer
+    on 64-bit ARM; anywhere else they are high resolution ticks.
+*/
+class StageProfiler
+{
+public:
+    static constexpr bool enabled = REVERB_PROFILING != 0;
+    static constexpr int max_stages = 8;
+
+    struct StageStats
+    {
+        juce::String name;
+        juce::uint64 calls = 0;
+        double mean = 0.0, p50 = 0.0, p99 = 0.0, max = 0.0;   // cycles per sample
+        double share = 0.0;   // of the total cycles in the block stage
+    };
+
+    struct BlockStats
+    {
+        juce::uint64 blocks = 0;
+        juce::uint64 deadline_misses = 0;
+        float worst_load = 0.0f;   // slowest block as a fraction of its period
+    };
+
+    // The last name is the stage that covers whole blocks and carries the deadline counts
+    explicit StageProfiler (const juce::StringArray& stageNames)
+        : names (stageNames)
+    {
+        jassert (names.size() <= max_stages);
+    }
+
+    static juce::uint64 readCycleCounter() noexcept
+    {
+       #if JUCE_INTEL
+        return (juce::uint64) __rdtsc();
+       #elif JUCE_ARM && JUCE_64BIT && ! JUCE_MSVC
+        juce::uint64 ticks;
+        asm volatile ("mrs %0, cntvct_el0" : "=r" (ticks));
+        return ticks;
+       #else
+        return (juce::uint64) juce::Time::getHighResolutionTicks();
+       #endif
+    }
+
+    // Times one stage over its lifetime. Compiles to nothing when profiling is off.
+    class ScopedProbe
+    {
+    public:
+       #if REVERB_PROFILING
+        ScopedProbe (StageProfiler& p, int s, int numSamples) noexcept
+            : profiler (p), stage (s), num_samples (numSamples), start (readCycleCounter()) {}
+
+        ~ScopedProbe() noexcept { profiler.record (stage, readCycleCounter() - start, num_samples); }
+
+       private:
+        StageProfiler& profiler;
+        const int stage, num_samples;
+        const juce::uint64 start;
+       #else
+        ScopedProbe (StageProfiler&, int, int) noexcept {}
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedProbe)
+    };
+
+    // Owning thread of the stage
+    void record (int stage, juce::uint64 cycles, int numSamples) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        auto& h = histograms[(size_t) stage];
+        const auto scaled = (juce::uint32) juce::jmin<juce::uint64> (cycles * fixed_point / (juce::uint64) numSamples,
+                                                                     std::numeric_limits<juce::uint32>::max());
+        bump (h.bins[(size_t) binFor (scaled)], 1);
+        bump (h.calls, 1);
+        bump (h.cycles, cycles);
+        bump (h.samples, (juce::uint64) numSamples);
+
+        if (scaled > h.max.load (std::memory_order_relaxed))
+            h.max.store (scaled, std::memory_order_relaxed);
+    }
+
+    // Audio thread, once per host block
+    void recordDeadline (juce::int64 elapsedTicks, juce::int64 periodTicks) noexcept
+    {
+        if (periodTicks <= 0)
+            return;
+
+        bump (blocks, 1);
+        if (elapsedTicks > periodTicks)
+            bump (deadline_misses, 1);
+
+        const auto load = (float) elapsedTicks / (float) periodTicks;
+        if (load > worst_load.load (std::memory_order_relaxed))
+            worst_load.store (load, std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    // Message thread from here on
+
+    int getNumStages() const { return names.size(); }
+
+    StageStats getStageStats (int stage) const
+    {
+        const auto& h = histograms[(size_t) stage];
+        const auto& total = histograms[(size_t) names.size() - 1];
+
+        std::array<juce::uint64, num_bins> counts;
+        juce::uint64 count = 0;
+        for (size_t i = 0; i < counts.size(); ++i)
+            count += counts[i] = h.bins[i].load (std::memory_order_relaxed);
+
+        StageStats stats;
+        stats.name = names[stage];
+        stats.calls = h.calls.load (std::memory_order_relaxed);
+
+        const auto samples = h.samples.load (std::memory_order_relaxed);
+        const auto cycles = h.cycles.load (std::memory_order_relaxed);
+        const auto total_cycles = total.cycles.load (std::memory_order_relaxed);
+
+        if (samples > 0)
+            stats.mean = (double) cycles / (double) samples;
+        if (total_cycles > 0)
+            stats.share = (double) cycles / (double) total_cycles;
+
+        stats.p50 = percentile (counts, count, 0.5);
+        stats.p99 = percentile (counts, count, 0.99);
+        stats.max = h.max.load (std::memory_order_relaxed) / (double) fixed_point;
+        return stats;
+    }
+
+    BlockStats getBlockStats() const
+    {
+        BlockStats stats;
+        stats.blocks = blocks.load (std::memory_order_relaxed);
+        stats.deadline_misses = deadline_misses.load (std::memory_order_relaxed);
+        stats.worst_load = worst_load.load (std::memory_order_relaxed);
+        return stats;
+    }
+
+    // One row per stage, block stage last with the deadline columns filled in
+    juce::String toCsv() const
+    {
+        juce::String csv = "stage,calls,mean_cycles_per_sample,p50_cycles_per_sample,p99_cycles_per_sample,"
+                           "max_cycles_per_sample,share,deadline_misses,worst_load\n";
+
+        const auto block = getBlockStats();
+
+        for (int stage = 0; stage < getNumStages(); ++stage)
+        {
+            const auto s = getStageStats (stage);
+            const bool is_block = stage == getNumStages() - 1;
+
+            csv << s.name << "," << juce::String (s.calls) << ","
+                << juce::String (s.mean, 2) << "," << juce::String (s.p50, 2) << ","
+                << juce::String (s.p99, 2) << "," << juce::String (s.max, 2) << ","
+                << juce::String (s.share, 4) << ","
+                << juce::String (is_block ? block.deadline_misses : 0) << ","
+                << juce::String (is_block ? block.worst_load : 0.0f, 4) << "\n";
+        }
+
+        return csv;
+    }
+
+    // Racing a record can leave a count or two behind; it never corrupts anything
+    void reset()
+    {
+        for (auto& h : histograms)
+        {
+            for (auto& bin : h.bins)
+                bin.store (0, std::memory_order_relaxed);
+
+            h.calls.store (0, std::memory_order_relaxed);
+            h.cycles.store (0, std::memory_order_relaxed);
+            h.samples.store (0, std::memory_order_relaxed);
+            h.max.store (0, std::memory_order_relaxed);
+        }
+
+        blocks.store (0, std::memory_order_relaxed);
+        deadline_misses.store (0, std::memory_order_relaxed);
+        worst_load.store (0.0f, std::memory_order_relaxed);
+    }
+
+private:
+    // Cycles per sample are kept in 1/16ths so cheap stages still spread over the bins
+    static constexpr juce::uint64 fixed_point = 16;
+    static constexpr int num_bins = 128;
+
+    struct Histogram
+    {
+        std::array<std::atomic<juce::uint64>, num_bins> bins {};
+        std::atomic<juce::uint64> calls { 0 }, cycles { 0 }, samples { 0 };
+        std::atomic<juce::uint32> max { 0 };
+    };
+
+    // Single writer, so a plain load and store is enough and avoids a locked add
+    static void bump (std::atomic<juce::uint64>& counter, juce::uint64 amount) noexcept
+    {
+        counter.store (counter.load (std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    // Four bins per octave: the top set bit picks the octave, the next two the quarter
+    static int binFor (juce::uint32 value) noexcept
+    {
+        if (value < 4)
+            return (int) value;
+
+        const int octave = juce::findHighestSetBit (value);
+        return 4 * (octave - 1) + (int) ((value >> (octave - 2)) & 3);
+    }
+
+    static double binCentre (int bin) noexcept
+    {
+        if (bin < 4)
+            return bin;
+
+        const int octave = bin / 4 + 1;
+        const double width = (double) (1u << (octave - 2));
+        return (4 + bin % 4) * width + 0.5 * width;
+    }
+
+    static double percentile (const std::array<juce::uint64, num_bins>& counts, juce::uint64 total, double q)
+    {
+        if (total == 0)
+            return 0.0;
+
+        const auto target = (juce::uint64) std::ceil (q * (double) total);
+        juce::uint64 seen = 0;
+
+        for (int bin = 0; bin < num_bins; ++bin)
+        {
+            seen += counts[(size_t) bin];
+            if (seen >= target)
+                return binCentre (bin) / (double) fixed_point;
+        }
+
+        return binCentre (num_bins - 1) / (double) fixed_point;
+    }
+
+    const juce::StringArray names;
+    std::array<Histogram, max_stages> histograms;
+
+    std::atomic<juce::uint64> blocks { 0 }, deadline_misses { 0 };
+    std::atomic<float> worst_load { 0.0f };
+
+    JUCE_DECLARE_NON_COPYABLE (StageProfiler)
+};
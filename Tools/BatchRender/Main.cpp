@@ -0,0 +1,451 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Offline batch renderer for LearningLiveProcessingAudioProcessor.
+
+    Runs WAV and AIFF files through the reverb without a host:
+
+        ReverbBatchRender [options] <file or folder> ...
+
+    Folders are searched recursively for .wav, .aif and .aiff files. Each
+    output is written next to its input (or into --out-dir) as
+    <name>_reverb.<ext>, in the same format and bit depth, always stereo.
+    The processor's latency is trimmed off the start, so the output lines up
+    with the input, and by default the reverb tail is rendered past the end.
+
+    Every worker thread owns one processor and renders whole files through
+    it in large chunks. Files are dealt out largest first to per-worker
+    queues, and a worker whose queue runs dry steals from the back of the
+    longest remaining one, so a few long files do not leave cores idle at
+    the end of a batch. Inputs are memory mapped where the format allows.
+
+    Options:
+        --threads=<n>         worker threads (default: one per CPU)
+        --out-dir=<folder>    where to write (default: next to each input)
+        --chunk=<samples>     samples per processBlock call (default 65536)
+        --no-tail             stop at the input length instead of rendering the tail
+        --tier=<name>         reverb network: eco, standard or dense (default standard)
+        --seed=<n>            topology seed, for renders that match a session or an
+                              earlier batch (default: random, the same for every file)
+        --size=<x>            parameter overrides, in the parameters' own units
+        --predelay=<ms>
+        --decay=<s>
+        --diffusion=<x>
+        --modulation=<x>
+        --damping=<x>
+        --early=<x>
+        --reduced-rate        run the network at 44.1/48 kHz on high sample rates
+        --half-precision      store the network's delay lines as 16 bit half floats
+        --simd=<level>        kernels to run: scalar, sse2, avx2 or avx512 (default: the
+                              best the CPU supports). scalar renders the reference output
+
+    Prints one line per file and a summary. The exit code is 1 if any file
+    failed.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <deque>
+#include <iostream>
+#include "PluginProcessor.h"
+
+//==============================================================================
+struct RenderSettings
+{
+    juce::File out_dir;
+    int chunk_size = 65536;
+    bool render_tail = true;
+    ReverbTier tier = ReverbTier::standard;
+    juce::uint32 seed = 0;
+    bool reduced_rate = false;
+    bool half_precision = false;
+    SimdLevel simd_level = SimdLevel::scalar;
+    juce::StringPairArray parameter_values;   // parameter ID -> value
+};
+
+struct RenderResult
+{
+    bool ok = false;
+    juce::String message;
+    double audio_seconds = 0.0;
+};
+
+//==============================================================================
+/**
+    Per-worker deques of files. A worker takes from the front of its own and,
+    once that is empty, from the back of whichever other deque is longest.
+    Files are coarse work items, so a lock per deque costs nothing measurable.
+*/
+class FileQueue
+{
+public:
+    FileQueue (const juce::Array<juce::File>& files, int numWorkers)
+        : queues ((size_t) numWorkers)
+    {
+        // Largest first, dealt round robin, so the initial split is already
+        // close to even. Each size is read once here; asking the file system
+        // from the comparison would do it O(n log n) times.
+        std::vector<std::pair<juce::int64, juce::File>> by_size;
+        by_size.reserve ((size_t) files.size());
+
+        for (auto& file : files)
+            by_size.emplace_back (file.getSize(), file);
+
+        std::sort (by_size.begin(), by_size.end(), [] (const auto& a, const auto& b)
+        {
+            return a.first > b.first;
+        });
+
+        for (size_t i = 0; i < by_size.size(); ++i)
+            queues[i % (size_t) numWorkers].files.push_back (by_size[i].second);
+    }
+
+    bool next (int worker, juce::File& file)
+    {
+        {
+            auto& own = queues[(size_t) worker];
+            const juce::ScopedLock lock (own.lock);
+
+            if (! own.files.empty())
+            {
+                file = own.files.front();
+                own.files.pop_front();
+                return true;
+            }
+        }
+
+        for (;;)
+        {
+            Queue* victim = nullptr;
+            size_t longest = 0;
+
+            for (auto& q : queues)
+            {
+                const juce::ScopedLock lock (q.lock);
+                if (q.files.size() > longest)
+                {
+                    longest = q.files.size();
+                    victim = &q;
+                }
+            }
+
+            if (victim == nullptr)
+                return false;
+
+            // Someone else may have emptied it since we looked
+            const juce::ScopedLock lock (victim->lock);
+            if (! victim->files.empty())
+            {
+                file = victim->files.back();
+                victim->files.pop_back();
+                return true;
+            }
+        }
+    }
+
+private:
+    struct Queue
+    {
+        juce::CriticalSection lock;
+        std::deque<juce::File> files;
+    };
+
+    std::vector<Queue> queues;
+};
+
+//==============================================================================
+static std::unique_ptr<juce::AudioFormatReader> open_reader (juce::AudioFormatManager& formats, const juce::File& file)
+{
+    if (auto* format = formats.findFormatForFileExtension (file.getFileExtension()))
+    {
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped (format->createMemoryMappedReader (file));
+
+        if (mapped != nullptr && mapped->mapEntireFile())
+            return mapped;
+    }
+
+    return std::unique_ptr<juce::AudioFormatReader> (formats.createReaderFor (file));
+}
+
+static juce::File output_file_for (const juce::File& input, const RenderSettings& settings)
+{
+    const auto name = input.getFileNameWithoutExtension() + "_reverb" + input.getFileExtension();
+    return settings.out_dir != juce::File() ? settings.out_dir.getChildFile (name) : input.getSiblingFile (name);
+}
+
+static RenderResult render_file (LearningLiveProcessingAudioProcessor& processor, juce::AudioFormatManager& formats,
+                                 const juce::File& input, const RenderSettings& settings)
+{
+    RenderResult result;
+
+    auto reader = open_reader (formats, input);
+    if (reader == nullptr)
+    {
+        result.message = "could not read";
+        return result;
+    }
+
+    // Written back in the format it came in
+    auto* format = formats.findFormatForFileExtension (input.getFileExtension());
+    if (format == nullptr)
+    {
+        result.message = "no writer for " + input.getFileExtension() + " files";
+        return result;
+    }
+
+    const auto output = output_file_for (input, settings);
+    const double sample_rate = reader->sampleRate;
+    const int bits = (int) reader->bitsPerSample;
+    const int chunk = settings.chunk_size;
+
+    // A plain FileOutputStream appends, so start from an empty file
+    output.deleteFile();
+    auto stream = std::make_unique<juce::FileOutputStream> (output, 1 << 20);
+
+    if (! stream->openedOk())
+    {
+        result.message = "could not create " + output.getFullPathName();
+        return result;
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor (stream.get(), sample_rate, 2, bits, {}, 0));
+    if (writer == nullptr)
+    {
+        result.message = "no " + juce::String (bits) + " bit stereo writer for " + format->getFormatName();
+        return result;
+    }
+
+    stream.release();   // the writer owns it now
+
+    // prepareToPlay starts from silence every time, and keeps its allocations
+    // when the rate has not changed, so one processor serves the whole batch
+    processor.setPlayConfigDetails (2, 2, sample_rate, chunk);
+    processor.prepareToPlay (sample_rate, chunk);
+
+    // The tail length already includes the latency
+    const juce::int64 latency = processor.getLatencySamples();
+    const juce::int64 extra = settings.render_tail ? juce::jmax (latency, (juce::int64) std::ceil (processor.getTailLengthSeconds() * sample_rate))
+                                                   : latency;
+    const juce::int64 input_length = reader->lengthInSamples;
+    const juce::int64 total = input_length + extra;
+
+    // Mono inputs are read into both channels; anything past the first two is ignored
+    juce::AudioBuffer<float> buffer (2, chunk);
+    juce::MidiBuffer midi;
+    juce::int64 to_skip = latency;
+
+    for (juce::int64 position = 0; position < total; position += chunk)
+    {
+        const int n = (int) juce::jmin ((juce::int64) chunk, total - position);
+        const int available = (int) juce::jlimit ((juce::int64) 0, (juce::int64) n, input_length - position);
+
+        if (available > 0)
+            reader->read (&buffer, 0, available, position, true, true);
+
+        buffer.clear (available, chunk - available);
+
+        juce::AudioBuffer<float> block (buffer.getArrayOfWritePointers(), 2, n);
+        processor.processBlock (block, midi);
+
+        const int skip = (int) juce::jmin ((juce::int64) n, to_skip);
+        to_skip -= skip;
+
+        if (skip < n && ! writer->writeFromAudioSampleBuffer (block, skip, n - skip))
+        {
+            result.message = "write failed";
+            return result;
+        }
+    }
+
+    result.ok = true;
+    result.audio_seconds = (double) input_length / sample_rate;
+    result.message = output.getFullPathName();
+    return result;
+}
+
+//==============================================================================
+class RenderWorker  : public juce::Thread
+{
+public:
+    RenderWorker (int index, FileQueue& q, const RenderSettings& s, juce::CriticalSection& log)
+        : juce::Thread ("Render worker " + juce::String (index)),
+          worker_index (index), queue (q), settings (s), log_lock (log), processor (s.tier)
+    {
+        // Everything is set here, before run() gets to prepareToPlay. The
+        // smoothers start from the parameter values at prepareToPlay, so a
+        // value set afterwards would glide in over the start of the first file.
+        formats.registerBasicFormats();
+        processor.setReducedRateEngine (settings.reduced_rate);
+        processor.setHalfPrecisionDelays (settings.half_precision);
+        processor.setSimdLevel (settings.simd_level);
+        processor.setTopologySeed (settings.seed);
+
+        for (auto& id : settings.parameter_values.getAllKeys())
+        {
+            if (auto* parameter = processor.getParameters().getParameter (id))
+            {
+                const float value = settings.parameter_values[id].getFloatValue();
+                parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+            }
+        }
+    }
+
+    void run() override
+    {
+        juce::File input;
+
+        while (! threadShouldExit() && queue.next (worker_index, input))
+        {
+            const auto start = juce::Time::getMillisecondCounterHiRes();
+            const auto result = render_file (processor, formats, input, settings);
+            const double elapsed = (juce::Time::getMillisecondCounterHiRes() - start) * 0.001;
+
+            const juce::ScopedLock lock (log_lock);
+
+            if (result.ok)
+            {
+                ++files_done;
+                audio_seconds += result.audio_seconds;
+                std::cout << input.getFullPathName() << " -> " << result.message << " ("
+                          << juce::String (result.audio_seconds / juce::jmax (elapsed, 1.0e-6), 1) << "x real time)" << std::endl;
+            }
+            else
+            {
+                ++files_failed;
+                std::cerr << "FAILED " << input.getFullPathName() << ": " << result.message << std::endl;
+            }
+        }
+    }
+
+    int files_done = 0, files_failed = 0;
+    double audio_seconds = 0.0;
+
+private:
+    const int worker_index;
+    FileQueue& queue;
+    const RenderSettings& settings;
+    juce::CriticalSection& log_lock;
+
+    juce::AudioFormatManager formats;
+    LearningLiveProcessingAudioProcessor processor;
+
+    JUCE_DECLARE_NON_COPYABLE (RenderWorker)
+};
+
+//==============================================================================
+static juce::Array<juce::File> collect_inputs (const juce::StringArray& paths)
+{
+    juce::Array<juce::File> files;
+
+    for (auto& path : paths)
+    {
+        const auto target = juce::File::getCurrentWorkingDirectory().getChildFile (path);
+
+        if (target.isDirectory())
+        {
+            for (auto& file : target.findChildFiles (juce::File::findFiles, true, "*.wav;*.aif;*.aiff"))
+                if (! file.getFileNameWithoutExtension().endsWith ("_reverb"))
+                    files.add (file);
+        }
+        else if (target.existsAsFile())
+        {
+            files.add (target);
+        }
+        else
+        {
+            std::cerr << "Not found: " << target.getFullPathName() << std::endl;
+        }
+    }
+
+    return files;
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juce_init;
+    juce::ArgumentList args (argc, argv);
+
+    RenderSettings settings;
+    settings.chunk_size = args.containsOption ("--chunk") ? juce::jmax (1, args.getValueForOption ("--chunk").getIntValue()) : 65536;
+    settings.render_tail = ! args.containsOption ("--no-tail");
+    settings.tier = getTierFromName (args.getValueForOption ("--tier"), ReverbTier::standard);
+    settings.reduced_rate = args.containsOption ("--reduced-rate");
+    settings.half_precision = args.containsOption ("--half-precision");
+    settings.simd_level = getSimdLevelFromName (args.getValueForOption ("--simd"), getSupportedSimdLevel());
+    settings.seed = args.containsOption ("--seed") ? (juce::uint32) args.getValueForOption ("--seed").getLargeIntValue()
+                                                   : (juce::uint32) juce::Random::getSystemRandom().nextInt();
+
+    if (args.containsOption ("--out-dir"))
+    {
+        settings.out_dir = args.getFileForOption ("--out-dir");
+
+        if (! settings.out_dir.createDirectory())
+        {
+            std::cerr << "Could not create " << settings.out_dir.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    for (auto* id : { ParameterIds::size, ParameterIds::predelay, ParameterIds::decay, ParameterIds::diffusion,
+                      ParameterIds::modulation, ParameterIds::damping, ParameterIds::early })
+    {
+        const auto option = "--" + juce::String (id);
+        if (args.containsOption (option))
+            settings.parameter_values.set (id, args.getValueForOption (option));
+    }
+
+    juce::StringArray paths;
+    for (auto& arg : args.arguments)
+        if (! arg.isOption())
+            paths.add (arg.text);
+
+    const auto inputs = collect_inputs (paths);
+    if (inputs.isEmpty())
+    {
+        std::cerr << "Usage: ReverbBatchRender [options] <file or folder> ..." << std::endl;
+        return 1;
+    }
+
+    const int num_threads = juce::jlimit (1, inputs.size(),
+                                          args.containsOption ("--threads") ? args.getValueForOption ("--threads").getIntValue()
+                                                                            : juce::SystemStats::getNumCpus());
+
+    FileQueue queue (inputs, num_threads);
+    juce::CriticalSection log_lock;
+    std::vector<std::unique_ptr<RenderWorker>> workers;
+
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+
+    // Every worker and its processor is built before any thread starts, so no
+    // render runs while the main thread is still setting up the others
+    for (int i = 0; i < num_threads; ++i)
+        workers.push_back (std::make_unique<RenderWorker> (i, queue, settings, log_lock));
+
+    for (auto& worker : workers)
+        worker->startThread();
+
+    int files_done = 0, files_failed = 0;
+    double audio_seconds = 0.0;
+
+    for (auto& worker : workers)
+    {
+        worker->waitForThreadToExit (-1);
+        files_done += worker->files_done;
+        files_failed += worker->files_failed;
+        audio_seconds += worker->audio_seconds;
+    }
+
+    const double elapsed = (juce::Time::getMillisecondCounterHiRes() - start) * 0.001;
+
+    std::cout << files_done << " files, " << juce::String (audio_seconds, 1) << " s of audio in "
+              << juce::String (elapsed, 2) << " s on " << num_threads << " threads ("
+              << juce::String (audio_seconds / juce::jmax (elapsed, 1.0e-6), 1) << "x real time)";
+
+    if (files_failed > 0)
+        std::cout << ", " << files_failed << " failed";
+
+    std::cout << std::endl;
+    return files_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,480 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Headless benchmark for LearningLiveProcessingAudioProcessor.
+
+    Sweeps block sizes and sample rates, runs the processor without an editor
+    and prints one CSV row per case:
+
+        sample_rate,block_size,tier,ns_per_sample,realtime_factor,
+        worst_block_us,worst_block_load,pipelined,reduced_rate,modulation,
+        latency_samples,half_precision,network_kib,simd,early
+
+    realtime_factor is processing time / audio time, so 0.01 means the reverb
+    used 1% of the real-time budget. worst_block_load is the slowest single
+    block as a fraction of that block's period. In pipelined mode only the
+    audio thread is timed; the worker threads' time is not counted.
+    network_kib is the memory the delay lines of the tier's network take;
+    the other tiers hold none until Quality switches to them. simd is the
+    instruction set the network's kernels ran on.
+
+    Options:
+        --seconds=<s>         audio rendered per case (default 10)
+        --tier=<name>         reverb network: eco, standard or dense (default standard)
+        --blocks=<a,b,...>    block sizes (default 16,32,...,4096)
+        --rates=<a,b,...>     sample rates (default 44100,48000,88200,96000,176400,192000)
+        --baseline=<file>     earlier CSV output to compare against
+        --tolerance=<x>       allowed ns/sample increase over the baseline (default 0.1 = 10%)
+        --pipelined           run the diffusion stages on worker threads
+        --reduced-rate        run the network at 44.1/48 kHz on high sample rates
+        --modulation=<x>      delay modulation depth, 0 to 1 (default 0, fixed delays)
+        --early=<x>           early reflections level, 0 to 1 (default 0, off)
+        --half-precision      store the network's delay lines as 16 bit half floats
+        --simd=<level>        kernels to run: scalar, sse2, avx2 or avx512 (default: the
+                              best the CPU supports; higher levels fall back to that)
+
+    With --baseline the exit code is 1 if any case regressed beyond the tolerance.
+
+    Accuracy checks, which render the wet signal instead of timing. Both use
+    the first of --rates and --blocks (default 48000 and 512), every tier
+    unless --tier is given, --seconds of audio (default 10) and the other
+    options above:
+
+        --check-simd[=<dB>]   render at every level up to the best the CPU supports
+                              and fail if any differs from scalar by more than
+                              <dB> relative to full scale (default -100)
+        --compare-half[=<dB>] render with float and with half precision delay lines
+                              and fail if the difference is less than <dB> below
+                              the wet signal (default 60)
+
+    Each prints one CSV row per render compared, and the exit code is 1 if
+    any of them failed. With --half-precision the levels only differ where a
+    rounding difference tips a sample into the next half float step, but
+    that is around -60 dB, so give --check-simd a tolerance to match.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "PluginProcessor.h"
+
+//==============================================================================
+struct BenchmarkResult
+{
+    double sample_rate = 0.0;
+    int block_size = 0;
+    ReverbTier tier = ReverbTier::standard;
+    double ns_per_sample = 0.0;
+    double realtime_factor = 0.0;
+    double worst_block_us = 0.0;
+    double worst_block_load = 0.0;
+    bool pipelined = false;
+    bool reduced_rate = false;
+    float modulation = 0.0f;
+    int latency_samples = 0;
+    bool half_precision = false;
+    double network_kib = 0.0;
+    SimdLevel simd_level = SimdLevel::scalar;
+    float early = 0.0f;
+};
+
+static void prepare_processor (LearningLiveProcessingAudioProcessor& processor, double sampleRate, int blockSize, bool pipelined,
+                               bool reducedRate, float modulation, bool halfPrecision, SimdLevel simdLevel, float early)
+{
+    processor.setPipelinedDiffusion (pipelined);
+    processor.setReducedRateEngine (reducedRate);
+    processor.setHalfPrecisionDelays (halfPrecision);
+    processor.setSimdLevel (simdLevel);
+
+    auto* modulation_parameter = processor.getParameters().getParameter (ParameterIds::modulation);
+    modulation_parameter->setValueNotifyingHost (modulation_parameter->convertTo0to1 (modulation));
+
+    auto* early_parameter = processor.getParameters().getParameter (ParameterIds::early);
+    early_parameter->setValueNotifyingHost (early_parameter->convertTo0to1 (early));
+
+    processor.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+    processor.prepareToPlay (sampleRate, blockSize);
+}
+
+static void fill_with_noise (juce::AudioBuffer<float>& buffer, juce::Random& random)
+{
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        float* data = buffer.getWritePointer (channel);
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+            data[i] = (random.nextFloat() * 2.0f - 1.0f) * 0.25f;
+    }
+}
+
+static BenchmarkResult run_case (double sampleRate, int blockSize, ReverbTier tier, double seconds, bool pipelined, bool reducedRate,
+                                 float modulation, bool halfPrecision, SimdLevel simdLevel, float early)
+{
+    LearningLiveProcessingAudioProcessor processor (tier);
+    prepare_processor (processor, sampleRate, blockSize, pipelined, reducedRate, modulation, halfPrecision, simdLevel, early);
+
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (1234);
+
+    // One second untimed so the delay lines are full and the caches are warm
+    const int warmup_blocks = (int) std::ceil (sampleRate / blockSize);
+    for (int b = 0; b < warmup_blocks; ++b)
+    {
+        fill_with_noise (buffer, random);
+        processor.processBlock (buffer, midi);
+    }
+
+    const int timed_blocks = juce::jmax (1, (int) std::ceil (seconds * sampleRate / blockSize));
+    const double ticks_per_second = (double) juce::Time::getHighResolutionTicksPerSecond();
+
+    juce::int64 total_ticks = 0;
+    juce::int64 worst_ticks = 0;
+
+    for (int b = 0; b < timed_blocks; ++b)
+    {
+        fill_with_noise (buffer, random);
+
+        const auto start = juce::Time::getHighResolutionTicks();
+        processor.processBlock (buffer, midi);
+        const auto elapsed = juce::Time::getHighResolutionTicks() - start;
+
+        total_ticks += elapsed;
+        worst_ticks = juce::jmax (worst_ticks, elapsed);
+    }
+
+    const int latency_samples = processor.getLatencySamples();
+    const size_t network_bytes = processor.getNetworkDelayBytes();
+    processor.releaseResources();
+
+    const double total_samples = (double) timed_blocks * blockSize;
+    const double total_seconds = (double) total_ticks / ticks_per_second;
+    const double worst_seconds = (double) worst_ticks / ticks_per_second;
+
+    BenchmarkResult result;
+    result.sample_rate = sampleRate;
+    result.block_size = blockSize;
+    result.tier = tier;
+    result.ns_per_sample = total_seconds * 1.0e9 / total_samples;
+    result.realtime_factor = total_seconds / (total_samples / sampleRate);
+    result.worst_block_us = worst_seconds * 1.0e6;
+    result.worst_block_load = worst_seconds / (blockSize / sampleRate);
+    result.pipelined = pipelined;
+    result.reduced_rate = reducedRate;
+    result.modulation = modulation;
+    result.latency_samples = latency_samples;
+    result.half_precision = halfPrecision;
+    result.network_kib = (double) network_bytes / 1024.0;
+    result.simd_level = processor.getSimdLevel();
+    result.early = early;
+    return result;
+}
+
+static juce::String to_csv_row (const BenchmarkResult& r)
+{
+    return juce::String (juce::roundToInt (r.sample_rate)) + ","
+         + juce::String (r.block_size) + ","
+         + getTierName (r.tier) + ","
+         + juce::String (r.ns_per_sample, 3) + ","
+         + juce::String (r.realtime_factor, 6) + ","
+         + juce::String (r.worst_block_us, 3) + ","
+         + juce::String (r.worst_block_load, 6) + ","
+         + juce::String (r.pipelined ? 1 : 0) + ","
+         + juce::String (r.reduced_rate ? 1 : 0) + ","
+         + juce::String (r.modulation, 2) + ","
+         + juce::String (r.latency_samples) + ","
+         + juce::String (r.half_precision ? 1 : 0) + ","
+         + juce::String (r.network_kib, 1) + ","
+         + getSimdLevelName (r.simd_level) + ","
+         + juce::String (r.early, 2);
+}
+
+//==============================================================================
+// ACCURACY CHECKS
+
+// Every render gets the same topology and the same input, so two renders
+// differ only by the option being compared
+static constexpr juce::uint32 check_topology_seed = 1;
+
+// The wet signal: the output with the dry input, delayed by the reported latency, taken off
+static juce::AudioBuffer<float> render (double sampleRate, int blockSize, ReverbTier tier, double seconds, bool pipelined, bool reducedRate,
+                                        float modulation, bool halfPrecision, SimdLevel simdLevel, float early)
+{
+    LearningLiveProcessingAudioProcessor processor (tier);
+    processor.setTopologySeed (check_topology_seed);
+    prepare_processor (processor, sampleRate, blockSize, pipelined, reducedRate, modulation, halfPrecision, simdLevel, early);
+
+    const int num_blocks = juce::jmax (1, (int) std::ceil (seconds * sampleRate / blockSize));
+    const int num_samples = num_blocks * blockSize;
+    juce::AudioBuffer<float> input (2, num_samples);
+    juce::AudioBuffer<float> output (2, num_samples);
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (1234);
+
+    for (int b = 0; b < num_blocks; ++b)
+    {
+        fill_with_noise (buffer, random);
+
+        for (int channel = 0; channel < 2; ++channel)
+            input.copyFrom (channel, b * blockSize, buffer, channel, 0, blockSize);
+
+        processor.processBlock (buffer, midi);
+
+        for (int channel = 0; channel < 2; ++channel)
+            output.copyFrom (channel, b * blockSize, buffer, channel, 0, blockSize);
+    }
+
+    const int latency = juce::jmin (processor.getLatencySamples(), num_samples);
+    for (int channel = 0; channel < 2; ++channel)
+        output.addFrom (channel, latency, input, channel, 0, num_samples - latency, -1.0f);
+
+    processor.releaseResources();
+    return output;
+}
+
+// Largest and RMS sample difference between two renders of the same length
+struct Difference
+{
+    double peak = 0.0;
+    double rms = 0.0;
+};
+
+static Difference difference (const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+{
+    Difference result;
+    double sum = 0.0;
+
+    for (int channel = 0; channel < a.getNumChannels(); ++channel)
+    {
+        const float* x = a.getReadPointer (channel);
+        const float* y = b.getReadPointer (channel);
+
+        for (int i = 0; i < a.getNumSamples(); ++i)
+        {
+            const double d = (double) x[i] - (double) y[i];
+            result.peak = juce::jmax (result.peak, std::abs (d));
+            sum += d * d;
+        }
+    }
+
+    result.rms = std::sqrt (sum / ((double) a.getNumChannels() * a.getNumSamples()));
+    return result;
+}
+
+static double rms (const juce::AudioBuffer<float>& buffer)
+{
+    double sum = 0.0;
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        sum += juce::square ((double) buffer.getRMSLevel (channel, 0, buffer.getNumSamples()));
+
+    return std::sqrt (sum / buffer.getNumChannels());
+}
+
+static double to_db (double gain) { return juce::Decibels::gainToDecibels (gain, -200.0); }
+
+// Renders each tier at every level up to the best the CPU supports and
+// compares them with scalar. Returns the number further from it than toleranceDb.
+static int check_simd_levels (const juce::Array<ReverbTier>& tiers, double sampleRate, int blockSize, double seconds, bool pipelined,
+                              bool reducedRate, float modulation, bool halfPrecision, float early, double toleranceDb)
+{
+    int failures = 0;
+
+    std::cout << "tier,simd,max_difference_db" << std::endl;
+
+    for (auto tier : tiers)
+    {
+        const auto reference = render (sampleRate, blockSize, tier, seconds, pipelined, reducedRate, modulation, halfPrecision,
+                                       SimdLevel::scalar, early);
+
+        for (auto level : { SimdLevel::sse2, SimdLevel::avx2, SimdLevel::avx512 })
+        {
+            if (level > getSupportedSimdLevel())
+                break;
+
+            const auto output = render (sampleRate, blockSize, tier, seconds, pipelined, reducedRate, modulation, halfPrecision, level, early);
+            const double difference_db = to_db (difference (reference, output).peak);
+
+            std::cout << getTierName (tier) << "," << getSimdLevelName (level) << "," << juce::String (difference_db, 1) << std::endl;
+
+            if (difference_db > toleranceDb)
+            {
+                std::cerr << "MISMATCH " << getTierName (tier) << ", " << getSimdLevelName (level) << ": " << difference_db
+                          << " dB from scalar, tolerance " << toleranceDb << " dB" << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    return failures;
+}
+
+// Renders each tier with float and with half precision delay lines. Returns
+// the number whose difference is less than marginDb below the wet signal.
+static int compare_half_precision (const juce::Array<ReverbTier>& tiers, double sampleRate, int blockSize, double seconds, bool pipelined,
+                                   bool reducedRate, float modulation, SimdLevel simdLevel, float early, double marginDb)
+{
+    int failures = 0;
+
+    std::cout << "tier,wet_rms_db,residual_rms_db,residual_peak_db,residual_below_wet_db" << std::endl;
+
+    for (auto tier : tiers)
+    {
+        const auto full = render (sampleRate, blockSize, tier, seconds, pipelined, reducedRate, modulation, false, simdLevel, early);
+        const auto half = render (sampleRate, blockSize, tier, seconds, pipelined, reducedRate, modulation, true, simdLevel, early);
+
+        const auto residual = difference (full, half);
+        const double wet_db = to_db (rms (full));
+        const double residual_db = to_db (residual.rms);
+        const double below_db = wet_db - residual_db;
+
+        std::cout << getTierName (tier) << "," << juce::String (wet_db, 1) << "," << juce::String (residual_db, 1) << ","
+                  << juce::String (to_db (residual.peak), 1) << "," << juce::String (below_db, 1) << std::endl;
+
+        if (below_db < marginDb)
+        {
+            std::cerr << "RESIDUAL " << getTierName (tier) << ": half precision is only " << below_db
+                      << " dB below the wet signal, margin " << marginDb << " dB" << std::endl;
+            ++failures;
+        }
+    }
+
+    return failures;
+}
+
+//==============================================================================
+static juce::Array<double> parse_list (const juce::String& text, juce::Array<double> fallback)
+{
+    if (text.isEmpty())
+        return fallback;
+
+    juce::Array<double> values;
+    for (auto& token : juce::StringArray::fromTokens (text, ",", ""))
+        if (token.trim().isNotEmpty())
+            values.add (token.trim().getDoubleValue());
+
+    return values;
+}
+
+// Returns the number of cases that are slower than the baseline by more than tolerance
+static int compare_with_baseline (const juce::Array<BenchmarkResult>& results, const juce::File& baselineFile, double tolerance)
+{
+    auto lines = juce::StringArray::fromLines (baselineFile.loadFileAsString());
+    int regressions = 0;
+
+    for (auto& line : lines)
+    {
+        auto fields = juce::StringArray::fromTokens (line, ",", "");
+        if (fields.size() < 4 || ! fields[0].containsOnly ("0123456789."))
+            continue;
+
+        const double rate = fields[0].getDoubleValue();
+        const int block = fields[1].getIntValue();
+        const auto tier = getTierFromName (fields[2], ReverbTier::standard);
+        const double baseline_ns = fields[3].getDoubleValue();
+        const bool pipelined = fields.size() > 7 && fields[7].getIntValue() != 0;
+        const bool reduced_rate = fields.size() > 8 && fields[8].getIntValue() != 0;
+        const float modulation = fields.size() > 9 ? fields[9].getFloatValue() : 0.0f;
+        const bool half_precision = fields.size() > 11 && fields[11].getIntValue() != 0;
+
+        // Rows from before the column ran on the 128 bit kernels
+        const auto simd_level = fields.size() > 13 ? getSimdLevelFromName (fields[13], SimdLevel::sse2) : SimdLevel::sse2;
+        const float early = fields.size() > 14 ? fields[14].getFloatValue() : 0.0f;
+
+        for (auto& r : results)
+        {
+            if (juce::approximatelyEqual (r.sample_rate, rate) && r.block_size == block && r.tier == tier
+                && r.pipelined == pipelined && r.reduced_rate == reduced_rate && r.half_precision == half_precision
+                && r.simd_level == simd_level && juce::approximatelyEqual (r.early, early)
+                && juce::approximatelyEqual (r.modulation, modulation) && r.ns_per_sample > baseline_ns * (1.0 + tolerance))
+            {
+                std::cerr << "REGRESSION " << rate << " Hz, " << block << " samples, " << getTierName (tier) << ": "
+                          << baseline_ns << " -> " << r.ns_per_sample << " ns/sample" << std::endl;
+                ++regressions;
+            }
+        }
+    }
+
+    return regressions;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juce_init;
+    juce::ArgumentList args (argc, argv);
+
+    const double seconds = args.containsOption ("--seconds") ? args.getValueForOption ("--seconds").getDoubleValue() : 10.0;
+    const auto tier = getTierFromName (args.getValueForOption ("--tier"), ReverbTier::standard);
+    const bool pipelined = args.containsOption ("--pipelined");
+    const bool reduced_rate = args.containsOption ("--reduced-rate");
+    const float modulation = args.containsOption ("--modulation") ? args.getValueForOption ("--modulation").getFloatValue() : 0.0f;
+    const bool half_precision = args.containsOption ("--half-precision");
+    const auto simd_level = getSimdLevelFromName (args.getValueForOption ("--simd"), getSupportedSimdLevel());
+    const float early = args.containsOption ("--early") ? args.getValueForOption ("--early").getFloatValue() : 0.0f;
+
+    if (args.containsOption ("--check-simd") || args.containsOption ("--compare-half"))
+    {
+        const double rate = parse_list (args.getValueForOption ("--rates"), { 48000 })[0];
+        const int block = (int) parse_list (args.getValueForOption ("--blocks"), { 512 })[0];
+
+        juce::Array<ReverbTier> tiers { ReverbTier::eco, ReverbTier::standard, ReverbTier::dense };
+        if (args.containsOption ("--tier"))
+            tiers = { tier };
+
+        int failures = 0;
+
+        if (args.containsOption ("--check-simd"))
+        {
+            const auto value = args.getValueForOption ("--check-simd");
+            const double tolerance_db = value.isNotEmpty() ? value.getDoubleValue() : -100.0;
+            failures += check_simd_levels (tiers, rate, block, seconds, pipelined, reduced_rate, modulation, half_precision, early, tolerance_db);
+        }
+
+        if (args.containsOption ("--compare-half"))
+        {
+            const auto value = args.getValueForOption ("--compare-half");
+            const double margin_db = value.isNotEmpty() ? value.getDoubleValue() : 60.0;
+            failures += compare_half_precision (tiers, rate, block, seconds, pipelined, reduced_rate, modulation, simd_level, early, margin_db);
+        }
+
+        return failures > 0 ? 1 : 0;
+    }
+
+    const auto block_sizes = parse_list (args.getValueForOption ("--blocks"),
+                                         { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 });
+    const auto sample_rates = parse_list (args.getValueForOption ("--rates"),
+                                          { 44100, 48000, 88200, 96000, 176400, 192000 });
+
+    juce::Array<BenchmarkResult> results;
+
+    std::cout << "sample_rate,block_size,tier,ns_per_sample,realtime_factor,worst_block_us,worst_block_load,pipelined,reduced_rate,modulation,latency_samples,half_precision,network_kib,simd,early" << std::endl;
+
+    for (auto rate : sample_rates)
+    {
+        for (auto block : block_sizes)
+        {
+            auto result = run_case (rate, (int) block, tier, seconds, pipelined, reduced_rate, modulation, half_precision, simd_level, early);
+            std::cout << to_csv_row (result) << std::endl;
+            results.add (result);
+        }
+    }
+
+    if (args.containsOption ("--baseline"))
+    {
+        const double tolerance = args.containsOption ("--tolerance") ? args.getValueForOption ("--tolerance").getDoubleValue() : 0.1;
+        const auto baseline = args.getFileForOption ("--baseline");
+
+        if (! baseline.existsAsFile())
+        {
+            std::cerr << "Baseline file not found: " << baseline.getFullPathName() << std::endl;
+            return 1;
+        }
+
+        if (compare_with_baseline (results, baseline, tolerance) > 0)
+            return 1;
+    }
+
+    return 0;
+}